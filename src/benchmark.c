@@ -0,0 +1,293 @@
+/*
+ * benchmark.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Cycle counts of hot code paths, measured with the DWT cycle counter.
+ *
+ * The float kernels follow the arm_math reference implementations of
+ * arm_dot_prod_f32, arm_fir_f32 and arm_biquad_cascade_df1_f32 (the
+ * CMSIS-DSP library itself is not part of the project). Build once with
+ * "Floating point: hard" and once with "software" to compare FPU and
+ * soft-float cycle counts.
+ */
+// first: arm_math.h includes core_cm4.h, which needs __FPU_PRESENT from it
+#include "stm32f4xx.h"
+#define ARM_MATH_CM4
+#include "arm_math.h"
+#include "benchmark.h"
+#include "kernel.h"
+
+#define BLOCK_SIZE 256
+#define FIR_TAPS 32
+#define BIQUAD_STAGES 4
+#define FORMAT_COUNT 64
+#define SWITCH_COUNT 256
+
+int siprintf(char *buf, const char *fmt, ...); // tiny_printf.c
+
+// Private function declarations
+
+static float32_t dotProduct(const float32_t *a, const float32_t *b, unsigned int length);
+static void fir(const float32_t *coefficients, float32_t *state, const float32_t *input, float32_t *output, unsigned int length);
+static void biquadCascade(const float32_t *coefficients, float32_t *state, const float32_t *input, float32_t *output, unsigned int length);
+#ifdef USE_KERNEL
+static void kernelBenchmarkMain(void *arg);
+static void kernelBenchmarkWaiter(void *arg);
+static void kernelBenchmarkYielder(void *arg);
+#endif
+
+// Private static variable definitions
+
+static float32_t input[BLOCK_SIZE];
+static float32_t output[BLOCK_SIZE];
+static float32_t firCoefficients[FIR_TAPS];
+static float32_t firState[FIR_TAPS + BLOCK_SIZE - 1];
+static float32_t biquadCoefficients[5 * BIQUAD_STAGES];
+static float32_t biquadState[4 * BIQUAD_STAGES];
+static char formatBuffer[32];
+
+#ifdef USE_KERNEL
+KERNEL_TASK_DEFINE(benchmarkMainTask, kernelBenchmarkMain, 0, 30, 512);
+KERNEL_TASK_DEFINE(benchmarkWaiterTask, kernelBenchmarkWaiter, 0, 31, 256);
+KERNEL_TASK_DEFINE(benchmarkYielderA, kernelBenchmarkYielder, (void *) 1, 29, 256);
+KERNEL_TASK_DEFINE(benchmarkYielderB, kernelBenchmarkYielder, (void *) 0, 29, 256);
+
+static KernelSemaphore wakeSemaphore;
+static KernelSemaphore doneSemaphore;
+static volatile unsigned int givenAt;
+static unsigned int wakeTotal;
+static unsigned int wakeMax;
+static unsigned int yieldTotal;
+#endif
+
+// Public variable definitions
+
+BenchmarkResult benchmarkResults[BENCHMARK_MAX_RESULTS];
+unsigned int benchmarkResultCount = 0;
+
+// result of the dot product, keeps the compiler from dropping the kernel
+volatile float32_t benchmarkSink;
+
+// Function definitions
+
+void initBenchmark()
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+unsigned int benchmarkStart()
+{
+	return DWT->CYCCNT;
+}
+
+/**
+ * Cycles elapsed since benchmarkStart(), valid across a counter wraparound.
+ */
+unsigned int benchmarkStop(unsigned int start)
+{
+	return DWT->CYCCNT - start;
+}
+
+void benchmarkRecord(const char *name, unsigned int cycles)
+{
+	if (benchmarkResultCount < BENCHMARK_MAX_RESULTS) {
+		benchmarkResults[benchmarkResultCount].name = name;
+		benchmarkResults[benchmarkResultCount].cycles = cycles;
+		benchmarkResultCount++;
+	}
+}
+
+void runBenchmarks()
+{
+	unsigned int start;
+
+	initBenchmark();
+
+	for (unsigned int i = 0; i < BLOCK_SIZE; i++) {
+		input[i] = (float32_t) ((int) (i * 37 % 101) - 50) / 50.0f;
+	}
+	for (unsigned int i = 0; i < FIR_TAPS; i++) {
+		firCoefficients[i] = 1.0f / FIR_TAPS;
+	}
+	for (unsigned int i = 0; i < BIQUAD_STAGES; i++) {
+		// low-pass, fc = fs / 10
+		biquadCoefficients[5 * i + 0] = 0.0675f;
+		biquadCoefficients[5 * i + 1] = 0.1349f;
+		biquadCoefficients[5 * i + 2] = 0.0675f;
+		biquadCoefficients[5 * i + 3] = 1.1430f;
+		biquadCoefficients[5 * i + 4] = -0.4128f;
+	}
+
+	start = benchmarkStart();
+	benchmarkSink = dotProduct(input, input, BLOCK_SIZE);
+	benchmarkRecord("dot_prod_f32 256", benchmarkStop(start));
+
+	start = benchmarkStart();
+	fir(firCoefficients, firState, input, output, BLOCK_SIZE);
+	benchmarkRecord("fir_f32 32x256", benchmarkStop(start));
+
+	start = benchmarkStart();
+	biquadCascade(biquadCoefficients, biquadState, input, output, BLOCK_SIZE);
+	benchmarkRecord("biquad_df1_f32 4x256", benchmarkStop(start));
+
+	// telemetry style integers, 10 decimal and 8 hex digits each
+	start = benchmarkStart();
+	for (unsigned int i = 0; i < FORMAT_COUNT; i++) {
+		siprintf(formatBuffer, "%u %08X", 4000000000u - i, 0xDEADBEEF ^ i);
+	}
+	benchmarkRecord("siprintf %u %08X x64", benchmarkStop(start));
+
+	start = benchmarkStart();
+	for (unsigned int i = 0; i < FORMAT_COUNT; i++) {
+		siprintf(formatBuffer, "%.3f %.4q15", input[i], (int) (input[i] * 32768.0f));
+	}
+	benchmarkRecord("siprintf %.3f %.4q15 x64", benchmarkStop(start));
+}
+
+static float32_t dotProduct(const float32_t *a, const float32_t *b, unsigned int length)
+{
+	float32_t sum = 0.0f;
+
+	for (unsigned int i = 0; i < length; i++) {
+		sum += a[i] * b[i];
+	}
+
+	return sum;
+}
+
+/**
+ * Direct form FIR, state holds the last FIR_TAPS - 1 inputs followed by
+ * the current block.
+ */
+static void fir(const float32_t *coefficients, float32_t *state, const float32_t *input, float32_t *output, unsigned int length)
+{
+	for (unsigned int i = 0; i < length; i++) {
+		state[FIR_TAPS - 1 + i] = input[i];
+	}
+
+	for (unsigned int n = 0; n < length; n++) {
+		float32_t acc = 0.0f;
+		for (unsigned int k = 0; k < FIR_TAPS; k++) {
+			acc += coefficients[k] * state[n + FIR_TAPS - 1 - k];
+		}
+		output[n] = acc;
+	}
+
+	for (unsigned int i = 0; i < FIR_TAPS - 1; i++) {
+		state[i] = state[length + i];
+	}
+}
+
+/**
+ * Direct form I biquads, coefficients {b0, b1, b2, a1, a2} and state
+ * {x[n-1], x[n-2], y[n-1], y[n-2]} per stage.
+ */
+static void biquadCascade(const float32_t *coefficients, float32_t *state, const float32_t *input, float32_t *output, unsigned int length)
+{
+	const float32_t *in = input;
+
+	for (unsigned int stage = 0; stage < BIQUAD_STAGES; stage++) {
+		const float32_t *c = &coefficients[5 * stage];
+		float32_t *s = &state[4 * stage];
+
+		for (unsigned int n = 0; n < length; n++) {
+			float32_t x = in[n];
+			float32_t y = c[0] * x + c[1] * s[0] + c[2] * s[1] + c[3] * s[2] + c[4] * s[3];
+			s[1] = s[0];
+			s[0] = x;
+			s[3] = s[2];
+			s[2] = y;
+			output[n] = y;
+		}
+
+		in = output;
+	}
+}
+
+#ifdef USE_KERNEL
+/**
+ * Adds the kernel benchmark tasks, they run once kernelStart() is called:
+ * a semaphore given to a higher priority task (give and switch), two tasks
+ * of equal priority yielding to each other (switch only), and the longest
+ * section run with interrupts masked anywhere since the reset (timer wheel,
+ * timebase, console, pools and kernel, see critical.h). Interrupt latency
+ * is that section plus the 12 cycle exception entry. A switch above
+ * KERNEL_MAX_SWITCH_CYCLES, or a section above KERNEL_MAX_MASKED_CYCLES,
+ * is recorded as over the bound. The free stack of the idle task is
+ * recorded in bytes.
+ */
+void runKernelBenchmarks()
+{
+	initBenchmark();
+
+	kernelSemInit(&wakeSemaphore, 0, 1);
+	kernelSemInit(&doneSemaphore, 0, 1);
+	kernelAddTask(&benchmarkWaiterTask);
+	kernelAddTask(&benchmarkMainTask);
+}
+
+static void kernelBenchmarkMain(void *arg)
+{
+	KernelStats kernelStats;
+
+	for (unsigned int i = 0; i < SWITCH_COUNT; i++) {
+		givenAt = benchmarkStart();
+		kernelSemGive(&wakeSemaphore);
+	}
+	benchmarkRecord(wakeTotal / SWITCH_COUNT > KERNEL_MAX_SWITCH_CYCLES
+			? "kernel sem give to task OVER BOUND" : "kernel sem give to task",
+			wakeTotal / SWITCH_COUNT);
+	benchmarkRecord(wakeMax > KERNEL_MAX_SWITCH_CYCLES
+			? "kernel sem give to task max OVER BOUND" : "kernel sem give to task max",
+			wakeMax);
+
+	kernelAddTask(&benchmarkYielderA);
+	kernelAddTask(&benchmarkYielderB);
+	kernelSemTake(&doneSemaphore, KERNEL_FOREVER);
+	benchmarkRecord(yieldTotal / (2 * SWITCH_COUNT) > KERNEL_MAX_SWITCH_CYCLES
+			? "kernel yield switch OVER BOUND" : "kernel yield switch",
+			yieldTotal / (2 * SWITCH_COUNT));
+
+	kernelGetStats(&kernelStats);
+	benchmarkRecord(kernelStats.maxMaskedCycles > KERNEL_MAX_MASKED_CYCLES
+			? "kernel masked max OVER BOUND" : "kernel masked max",
+			kernelStats.maxMaskedCycles);
+
+	// deferred timer callbacks ran on it meanwhile
+	benchmarkRecord("kernel idle stack free", kernelGetStackFree(&kernelIdleTask));
+}
+
+static void kernelBenchmarkWaiter(void *arg)
+{
+	for (unsigned int i = 0; i < SWITCH_COUNT; i++) {
+		kernelSemTake(&wakeSemaphore, KERNEL_FOREVER);
+
+		unsigned int cycles = benchmarkStop(givenAt);
+		wakeTotal += cycles;
+		if (cycles > wakeMax) {
+			wakeMax = cycles;
+		}
+	}
+}
+
+/**
+ * Each yield of one task switches to the other, the measuring task sees
+ * two switches per iteration.
+ */
+static void kernelBenchmarkYielder(void *arg)
+{
+	unsigned int start = benchmarkStart();
+
+	for (unsigned int i = 0; i < SWITCH_COUNT; i++) {
+		kernelYield();
+	}
+
+	if (arg) {
+		yieldTotal = benchmarkStop(start);
+		kernelSemGive(&doneSemaphore);
+	}
+}
+#endif /* USE_KERNEL */
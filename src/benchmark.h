@@ -0,0 +1,31 @@
+/*
+ * benchmark.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#define BENCHMARK_MAX_RESULTS 16
+
+typedef struct {
+	const char *name;
+	unsigned int cycles;
+} BenchmarkResult;
+
+// inspect in debug mode after runBenchmarks()
+extern BenchmarkResult benchmarkResults[BENCHMARK_MAX_RESULTS];
+extern unsigned int benchmarkResultCount;
+
+void initBenchmark();
+unsigned int benchmarkStart();
+unsigned int benchmarkStop(unsigned int start);
+void benchmarkRecord(const char *name, unsigned int cycles);
+void runBenchmarks();
+#ifdef USE_KERNEL
+void runKernelBenchmarks();
+#endif
+
+#endif /* BENCHMARK_H_ */
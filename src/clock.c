@@ -0,0 +1,214 @@
+/*
+ * clock.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Runtime switching between performance levels.
+ *
+ * A switch always goes through HSI: SYSCLK moves to HSI, the PLL is
+ * stopped (the regulator scale can only change while it is off), then the
+ * PLL is reconfigured and SYSCLK moves back to it. Flash wait states are
+ * raised before running faster and lowered only after running slower.
+ */
+#include "stm32f4xx.h"
+#include "clock.h"
+#include "timer.h"
+
+#define PLL_M (HSE_VALUE / 1000000) // 1 MHz PLL input
+
+typedef struct {
+	uint32_t pllN;
+	uint32_t pllP;    // 0: no PLL, SYSCLK from HSI
+	uint32_t pllQ;    // USB/SDIO/RNG clock, 48 MHz where possible
+	uint32_t latency; // flash wait states at 2.7 V to 3.6 V
+	uint32_t ppre1;   // APB1 at most 42 MHz
+	uint32_t ppre2;   // APB2 at most 84 MHz
+	uint32_t scale1;  // regulator scale 1 is needed above 144 MHz
+} ClockLevelConfig;
+
+// Private function declarations
+
+static void switchSysClock(uint32_t source);
+static void setFlashLatency(uint32_t latency);
+static void notifyListeners(void);
+
+// Private static variable definitions
+
+static const ClockLevelConfig levels[CLOCK_LEVEL_COUNT] = {
+	[CLOCK_LEVEL_168MHZ] = { 336, 2, 7, FLASH_ACR_LATENCY_5WS, RCC_CFGR_PPRE1_DIV4, RCC_CFGR_PPRE2_DIV2, 1 },
+	[CLOCK_LEVEL_120MHZ] = { 240, 2, 5, FLASH_ACR_LATENCY_3WS, RCC_CFGR_PPRE1_DIV4, RCC_CFGR_PPRE2_DIV2, 0 },
+	[CLOCK_LEVEL_84MHZ]  = { 336, 4, 7, FLASH_ACR_LATENCY_2WS, RCC_CFGR_PPRE1_DIV2, RCC_CFGR_PPRE2_DIV1, 0 },
+	[CLOCK_LEVEL_48MHZ]  = { 192, 4, 4, FLASH_ACR_LATENCY_1WS, RCC_CFGR_PPRE1_DIV2, RCC_CFGR_PPRE2_DIV1, 0 },
+	[CLOCK_LEVEL_HSI]    = {   0, 0, 0, FLASH_ACR_LATENCY_0WS, RCC_CFGR_PPRE1_DIV1, RCC_CFGR_PPRE2_DIV1, 0 },
+};
+
+static ClockChangeListener listeners[CLOCK_MAX_LISTENERS];
+static unsigned int listenerCount = 0;
+
+#ifdef FAST_BOOT
+// notifies the listeners of the background bring-up from the idle loop
+static Timer readyTimer;
+#endif
+
+// Function definitions
+
+/**
+ * Switches SYSCLK and the bus prescalers to a performance level, then
+ * notifies the registered listeners.
+ *
+ * Must be called from thread context, outside any peripheral transfer.
+ * Returns 1 when HSE does not start, SYSCLK then stays on HSI.
+ */
+char clockSetLevel(ClockLevel level)
+{
+	if (level >= CLOCK_LEVEL_COUNT) {
+		return 1;
+	}
+
+#ifdef FAST_BOOT
+	// the RCC interrupt still owns the clock tree
+	if (!SystemClockIsReady()) {
+		return 1;
+	}
+#endif
+
+	const ClockLevelConfig *config = &levels[level];
+
+	// run from HSI while the PLL is reconfigured
+	RCC->CR |= RCC_CR_HSION;
+	while (!(RCC->CR & RCC_CR_HSIRDY)) {}
+	switchSysClock(RCC_CFGR_SW_HSI);
+
+	RCC->CR &= ~RCC_CR_PLLON;
+	while (RCC->CR & RCC_CR_PLLRDY) {}
+
+	RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2))
+			| RCC_CFGR_HPRE_DIV1 | config->ppre1 | config->ppre2;
+
+	if (config->pllP == 0) {
+		setFlashLatency(config->latency);
+
+		RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+		PWR->CR &= ~PWR_CR_VOS;
+		RCC->CR &= ~RCC_CR_HSEON;
+	} else {
+		volatile uint32_t startUpCounter = 0;
+
+		RCC->CR |= RCC_CR_HSEON;
+		while (!(RCC->CR & RCC_CR_HSERDY) && startUpCounter != HSE_STARTUP_TIMEOUT) {
+			startUpCounter++;
+		}
+		if (!(RCC->CR & RCC_CR_HSERDY)) {
+			RCC->CR &= ~RCC_CR_HSEON;
+			RCC->CFGR &= ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2);
+			setFlashLatency(levels[CLOCK_LEVEL_HSI].latency);
+			SystemCoreClockUpdate();
+			notifyListeners();
+			return 1;
+		}
+
+		RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+		if (config->scale1) {
+			PWR->CR |= PWR_CR_VOS;
+		} else {
+			PWR->CR &= ~PWR_CR_VOS;
+		}
+
+		RCC->PLLCFGR = PLL_M | (config->pllN << 6) | (((config->pllP >> 1) - 1) << 16)
+				| RCC_PLLCFGR_PLLSRC_HSE | (config->pllQ << 24);
+		RCC->CR |= RCC_CR_PLLON;
+		while (!(RCC->CR & RCC_CR_PLLRDY)) {}
+
+		// still on HSI, any latency is safe here
+		setFlashLatency(config->latency);
+		switchSysClock(RCC_CFGR_SW_PLL);
+	}
+
+	SystemCoreClockUpdate();
+	notifyListeners();
+
+	return 0;
+}
+
+char clockRegisterListener(ClockChangeListener listener)
+{
+	for (unsigned int i = 0; i < listenerCount; i++) {
+		if (listeners[i] == listener) {
+			return 0;
+		}
+	}
+
+	if (listenerCount >= CLOCK_MAX_LISTENERS) {
+		return 1;
+	}
+
+	listeners[listenerCount++] = listener;
+
+	return 0;
+}
+
+uint32_t clockGetHCLK(void)
+{
+	return SystemCoreClock;
+}
+
+uint32_t clockGetPCLK1(void)
+{
+	uint32_t ppre = (RCC->CFGR & RCC_CFGR_PPRE1) >> 10;
+
+	// 0xx: not divided, 1xx: divided by 2 << xx
+	return ppre & 0x4 ? SystemCoreClock >> ((ppre & 0x3) + 1) : SystemCoreClock;
+}
+
+uint32_t clockGetPCLK2(void)
+{
+	uint32_t ppre = (RCC->CFGR & RCC_CFGR_PPRE2) >> 13;
+
+	return ppre & 0x4 ? SystemCoreClock >> ((ppre & 0x3) + 1) : SystemCoreClock;
+}
+
+#ifdef FAST_BOOT
+static void notifyReady(void *arg)
+{
+	notifyListeners();
+}
+
+/**
+ * The background bring-up is a clock change like any other, but this runs
+ * in the RCC interrupt: listeners reprogram peripherals that thread code
+ * may be using, so they are called from the idle loop instead. Without any
+ * listener there is nothing to notify; the first one (timebaseInit()) is
+ * registered once the tick, which the deferred timer needs, is configured.
+ */
+void SystemClockReady_Callback(void)
+{
+	if (listenerCount == 0) {
+		return;
+	}
+
+	timerInit(&readyTimer, notifyReady, 0, TIMER_DEFERRED);
+	timerStart(&readyTimer, 0, 0);
+}
+#endif
+
+static void switchSysClock(uint32_t source)
+{
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | source;
+	while ((RCC->CFGR & RCC_CFGR_SWS) != source << 2) {}
+}
+
+static void setFlashLatency(uint32_t latency)
+{
+	FLASH->ACR = FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN | latency;
+
+	// the new latency must be in effect before the clock changes
+	while ((FLASH->ACR & FLASH_ACR_LATENCY) != latency) {}
+}
+
+static void notifyListeners(void)
+{
+	for (unsigned int i = 0; i < listenerCount; i++) {
+		listeners[i]();
+	}
+}
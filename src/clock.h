@@ -0,0 +1,52 @@
+/*
+ * clock.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+
+#define CLOCK_MAX_LISTENERS 8
+
+/*
+ * Performance levels. PLL levels run from HSE (HSE_VALUE must match the
+ * crystal), the HSI level turns the PLL and HSE off.
+ */
+typedef enum {
+	CLOCK_LEVEL_168MHZ,
+	CLOCK_LEVEL_120MHZ,
+	CLOCK_LEVEL_84MHZ,
+	CLOCK_LEVEL_48MHZ,
+	CLOCK_LEVEL_HSI, // 16 MHz
+	CLOCK_LEVEL_COUNT
+} ClockLevel;
+
+// Called after every clock change, to recompute peripheral dividers
+typedef void (*ClockChangeListener)(void);
+
+char clockSetLevel(ClockLevel level);
+char clockRegisterListener(ClockChangeListener listener);
+uint32_t clockGetHCLK(void);
+uint32_t clockGetPCLK1(void);
+uint32_t clockGetPCLK2(void);
+
+#ifdef FAST_BOOT
+/*
+ * Fast boot (define FAST_BOOT): SystemInit leaves SYSCLK on the 16 MHz HSI
+ * and main starts immediately. HSE and the PLL come up in the background
+ * through the RCC interrupt, then SYSCLK switches to the PLL. If HSE has
+ * not started after FAST_BOOT_HSE_TIMEOUT ms, SYSCLK stays on HSI. Work
+ * that should not wait for full speed simply runs at the start of main.
+ * The listeners hear of the switch from the idle loop, through a deferred
+ * timer.
+ */
+void SystemClock_IRQHandler(void);
+uint32_t SystemClockIsReady(void);
+void SystemClockReady_Callback(void);
+#endif /* FAST_BOOT */
+
+#endif /* CLOCK_H_ */
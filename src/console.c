@@ -0,0 +1,256 @@
+/*
+ * console.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Writers own the head of the ring, the DMA completion interrupt owns the
+ * tail. Both, and the decision to start a transfer, are updated with
+ * interrupts masked so that writes from handlers and from the main loop
+ * can interleave; the copy is the only work done in that window.
+ */
+#include <string.h>
+#include "stm32f4xx.h"
+#include "console.h"
+#include "clock.h"
+#include "critical.h"
+
+#define TX_MASK (CONSOLE_TX_BUFFER_SIZE - 1)
+
+typedef struct {
+	USART_TypeDef *usart;
+	uint32_t usartClock;      // RCC APB1 enable bit
+	GPIO_TypeDef *gpio;
+	uint32_t gpioClock;       // RCC AHB1 enable bit
+	uint16_t pin;
+	uint8_t pinSource;
+	uint8_t alternateFunction;
+	DMA_Stream_TypeDef *stream;
+	uint32_t channel;
+	uint32_t transferComplete; // DMA_IT_TCIFx of the stream
+	uint32_t streamFlags;      // every DMA_FLAG_xxIFx of the stream
+	IRQn_Type irq;
+} ConsolePortConfig;
+
+// Private function declarations
+
+static void startTransfer(void);
+static void updateBaudRate(void);
+
+// Private static variable definitions
+
+static const ConsolePortConfig ports[] = {
+	[CONSOLE_USART2] = {
+		USART2, RCC_APB1Periph_USART2, GPIOA, RCC_AHB1Periph_GPIOA,
+		GPIO_Pin_2, GPIO_PinSource2, GPIO_AF_USART2,
+		DMA1_Stream6, DMA_Channel_4, DMA_IT_TCIF6,
+		DMA_FLAG_FEIF6 | DMA_FLAG_DMEIF6 | DMA_FLAG_TEIF6 | DMA_FLAG_HTIF6 | DMA_FLAG_TCIF6,
+		DMA1_Stream6_IRQn
+	},
+	[CONSOLE_USART3] = {
+		USART3, RCC_APB1Periph_USART3, GPIOD, RCC_AHB1Periph_GPIOD,
+		GPIO_Pin_8, GPIO_PinSource8, GPIO_AF_USART3,
+		DMA1_Stream3, DMA_Channel_4, DMA_IT_TCIF3,
+		DMA_FLAG_FEIF3 | DMA_FLAG_DMEIF3 | DMA_FLAG_TEIF3 | DMA_FLAG_HTIF3 | DMA_FLAG_TCIF3,
+		DMA1_Stream3_IRQn
+	},
+};
+
+static const ConsolePortConfig *config = 0;
+static uint32_t consoleBaudRate;
+static ConsolePolicy consolePolicy = CONSOLE_DROP;
+
+// DMA reads the ring, it must stay in SRAM (not CCM-RAM)
+static char txBuffer[CONSOLE_TX_BUFFER_SIZE];
+static volatile unsigned int head = 0;     // next byte written
+static volatile unsigned int tail = 0;     // next byte sent
+static volatile unsigned int inFlight = 0; // bytes of the running transfer
+
+static ConsoleStats stats;
+
+// Function definitions
+
+/**
+ * Configures the USART transmitter and its DMA stream. Output written
+ * before this call is dropped.
+ */
+void consoleInit(ConsolePort port, uint32_t baudRate, ConsolePolicy policy)
+{
+	GPIO_InitTypeDef gpioInit;
+	DMA_InitTypeDef dmaInit;
+
+	config = &ports[port];
+	consoleBaudRate = baudRate;
+	consolePolicy = policy;
+
+	RCC_AHB1PeriphClockCmd(config->gpioClock | RCC_AHB1Periph_DMA1, ENABLE);
+	RCC_APB1PeriphClockCmd(config->usartClock, ENABLE);
+
+	// TX pin
+	GPIO_PinAFConfig(config->gpio, config->pinSource, config->alternateFunction);
+	GPIO_StructInit(&gpioInit);
+	gpioInit.GPIO_Pin = config->pin;
+	gpioInit.GPIO_Mode = GPIO_Mode_AF;
+	gpioInit.GPIO_Speed = GPIO_Speed_25MHz;
+	gpioInit.GPIO_PuPd = GPIO_PuPd_UP;
+	GPIO_Init(config->gpio, &gpioInit);
+
+	// USART, transmitter only; follows APB1 clock changes
+	updateBaudRate();
+	clockRegisterListener(updateBaudRate);
+	USART_DMACmd(config->usart, USART_DMAReq_Tx, ENABLE);
+	USART_Cmd(config->usart, ENABLE);
+
+	// DMA, memory to peripheral. Address and length are set per transfer
+	DMA_DeInit(config->stream);
+	DMA_StructInit(&dmaInit);
+	dmaInit.DMA_Channel = config->channel;
+	dmaInit.DMA_PeripheralBaseAddr = (uint32_t) &config->usart->DR;
+	dmaInit.DMA_Memory0BaseAddr = (uint32_t) txBuffer;
+	dmaInit.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+	dmaInit.DMA_BufferSize = 1;
+	dmaInit.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	dmaInit.DMA_Priority = DMA_Priority_Low;
+	DMA_Init(config->stream, &dmaInit);
+	DMA_ITConfig(config->stream, DMA_IT_TC, ENABLE);
+
+	// lowest, output is never urgent
+	NVIC_SetPriority(config->irq, (1 << __NVIC_PRIO_BITS) - 1);
+	NVIC_EnableIRQ(config->irq);
+}
+
+void consoleSetPolicy(ConsolePolicy policy)
+{
+	consolePolicy = policy;
+}
+
+/**
+ * Copies data into the TX ring buffer and starts sending it if the DMA
+ * stream is idle. Returns the number of bytes accepted, less than length
+ * only when bytes were dropped.
+ *
+ * The blocking policy falls back to dropping in interrupt handlers and
+ * with interrupts masked, where the DMA interrupt could never free room.
+ */
+int consoleWrite(const char *data, int length)
+{
+	int accepted = 0;
+
+	if (config == 0 || length <= 0) {
+		return config ? 0 : length;
+	}
+
+	while (accepted < length) {
+		uint32_t primask = criticalEnter();
+
+		unsigned int used = (head - tail) & TX_MASK;
+		unsigned int room = TX_MASK - used; // one byte kept free to tell full from empty
+		unsigned int count = length - accepted;
+		if (count > room) {
+			count = room;
+		}
+
+		// at most two copies, the ring may wrap
+		unsigned int index = head & TX_MASK;
+		unsigned int first = CONSOLE_TX_BUFFER_SIZE - index;
+		if (first > count) {
+			first = count;
+		}
+		memcpy(&txBuffer[index], data + accepted, first);
+		memcpy(txBuffer, data + accepted + first, count - first);
+		head = (head + count) & TX_MASK;
+
+		accepted += count;
+		stats.written += count;
+		if (used + count > stats.peak) {
+			stats.peak = used + count;
+		}
+
+		if (inFlight == 0) {
+			startTransfer();
+		}
+
+		criticalExit(primask);
+
+		if (accepted < length) {
+			if (consolePolicy == CONSOLE_DROP || __get_IPSR() != 0 || primask) {
+				stats.dropped += length - accepted;
+				break;
+			}
+			// room is freed by the DMA interrupt
+			while (((head - tail) & TX_MASK) == TX_MASK);
+		}
+	}
+
+	return accepted;
+}
+
+/**
+ * Waits until everything written has been sent, for instance before a
+ * reset or a clock change. Thread context only.
+ */
+void consoleFlush(void)
+{
+	if (config == 0) {
+		return;
+	}
+
+	while (head != tail);
+	while (USART_GetFlagStatus(config->usart, USART_FLAG_TC) == RESET);
+}
+
+void consoleGetStats(ConsoleStats *statistics)
+{
+	uint32_t primask = criticalEnter();
+	*statistics = stats;
+	criticalExit(primask);
+}
+
+/**
+ * DMA transfer complete: releases the bytes sent and starts the next span.
+ * Called from the DMA1 stream interrupt of the console port.
+ */
+void consoleDmaIRQHandler(void)
+{
+	if (config == 0 || DMA_GetITStatus(config->stream, config->transferComplete) == RESET) {
+		return;
+	}
+	DMA_ClearITPendingBit(config->stream, config->transferComplete);
+
+	tail = (tail + inFlight) & TX_MASK;
+	inFlight = 0;
+	startTransfer();
+}
+
+/**
+ * Sends the bytes between tail and head, up to the end of the buffer.
+ * Called with interrupts masked or from the DMA interrupt.
+ */
+static void startTransfer(void)
+{
+	if (head == tail) {
+		return;
+	}
+
+	unsigned int count = (head > tail ? head : CONSOLE_TX_BUFFER_SIZE) - tail;
+
+	DMA_ClearFlag(config->stream, config->streamFlags);
+	config->stream->M0AR = (uint32_t) &txBuffer[tail];
+	DMA_SetCurrDataCounter(config->stream, count);
+	inFlight = count;
+	stats.transfers++;
+	DMA_Cmd(config->stream, ENABLE);
+}
+
+/**
+ * Recomputes the baud rate divider from the current APB1 clock.
+ */
+static void updateBaudRate(void)
+{
+	USART_InitTypeDef usartInit;
+
+	USART_StructInit(&usartInit);
+	usartInit.USART_BaudRate = consoleBaudRate;
+	usartInit.USART_Mode = USART_Mode_Tx;
+	USART_Init(config->usart, &usartInit);
+}
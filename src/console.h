@@ -0,0 +1,48 @@
+/*
+ * console.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Non-blocking UART console. Writes are copied into a TX ring buffer and
+ * DMA1 sends them in the background, one contiguous span of the ring per
+ * transfer. _write (syscalls.c) sends stdout and stderr here.
+ *
+ * Ports (8 data bits, no parity, 1 stop bit):
+ *   CONSOLE_USART2  TX on PA2, DMA1 stream 6 channel 4
+ *   CONSOLE_USART3  TX on PD8, DMA1 stream 3 channel 4
+ */
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+
+#define CONSOLE_TX_BUFFER_SIZE 1024 // power of two
+
+typedef enum {
+	CONSOLE_USART2,
+	CONSOLE_USART3
+} ConsolePort;
+
+// What a write does when the ring buffer is full
+typedef enum {
+	CONSOLE_DROP,  // keep what fits, count the rest as dropped
+	CONSOLE_BLOCK  // wait for DMA to make room (thread context only)
+} ConsolePolicy;
+
+typedef struct {
+	unsigned int written;  // bytes accepted in the ring buffer
+	unsigned int dropped;  // bytes lost to a full buffer
+	unsigned int transfers;
+	unsigned int peak;     // highest ring buffer fill
+} ConsoleStats;
+
+void consoleInit(ConsolePort port, uint32_t baudRate, ConsolePolicy policy);
+void consoleSetPolicy(ConsolePolicy policy);
+int consoleWrite(const char *data, int length);
+void consoleFlush(void);
+void consoleGetStats(ConsoleStats *statistics);
+void consoleDmaIRQHandler(void);
+
+#endif /* CONSOLE_H_ */
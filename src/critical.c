@@ -0,0 +1,26 @@
+/*
+ * critical.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "critical.h"
+
+// start of the outermost section, only valid while it runs
+uint32_t criticalSince = 0;
+
+volatile uint32_t criticalMaxCycles = 0;
+
+/**
+ * Longest section run with interrupts masked since the reset (or the last
+ * criticalResetMax()), in cycles.
+ */
+uint32_t criticalGetMaxCycles(void)
+{
+	return criticalMaxCycles;
+}
+
+void criticalResetMax(void)
+{
+	criticalMaxCycles = 0;
+}
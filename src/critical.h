@@ -0,0 +1,68 @@
+/*
+ * critical.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Sections run with interrupts masked (PRIMASK).
+ *
+ * Every masked section goes through criticalEnter() and criticalExit(),
+ * which time the outermost one with the DWT cycle counter; a nested
+ * section counts as part of the one around it. criticalGetMaxCycles() is
+ * then the longest time any interrupt could wait before its entry, the
+ * bound on interrupt latency. Sections must stay O(1) or loop over a
+ * bounded number of items: anything longer unmasks between steps.
+ *
+ *   uint32_t primask = criticalEnter();
+ *   ...
+ *   criticalExit(primask);
+ *
+ * timerIdle(), masking around WFI, is not a section: the core sleeps,
+ * and an interrupt wakes it and is taken right after.
+ *
+ * The counter runs once timebaseInit() started it, sections before that
+ * measure 0.
+ */
+
+#ifndef CRITICAL_H_
+#define CRITICAL_H_
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+extern uint32_t criticalSince;
+extern volatile uint32_t criticalMaxCycles;
+
+static inline void criticalRecord(uint32_t cycles)
+{
+	if (cycles > criticalMaxCycles) {
+		criticalMaxCycles = cycles;
+	}
+}
+
+/**
+ * Masks interrupts, returns the previous PRIMASK for criticalExit().
+ */
+static inline uint32_t criticalEnter(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (!primask) {
+		criticalSince = DWT->CYCCNT;
+	}
+	return primask;
+}
+
+static inline void criticalExit(uint32_t primask)
+{
+	if (!primask) {
+		criticalRecord(DWT->CYCCNT - criticalSince);
+	}
+	__set_PRIMASK(primask);
+}
+
+uint32_t criticalGetMaxCycles(void);
+void criticalResetMax(void);
+
+#endif /* CRITICAL_H_ */
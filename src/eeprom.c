@@ -7,6 +7,11 @@
 #include "stm32f4xx.h"
 #include "macros_utiles.h"
 #include "eeprom.h"
+#include "clock.h"
+#include "sections.h"
+#include "itm.h"
+#include "log.h"
+#include "timebase.h"
 
 #define BSY_FLAG BIT7
 #define TXE_FLAG BIT1
@@ -15,25 +20,84 @@
 
 #define SPI_ALTERNATE_FUNCTION 0x5
 #define GPIO_ALTERNATE_FUNCTION 0b10
-#define EEPROM_DELAY_TICKS 10 // at least 50 ns
+#define EEPROM_CS_DISABLE_NS 50 // chip select high time between commands
+#define EEPROM_SPI_MAX_FREQUENCY 1000000 // datasheet allows 5 MHz at 3.3 V
+#define EEPROM_WRITE_TIMEOUT_US 10000 // twice the 5 ms write cycle
+#define SPI_BR_MASK (0b111 << 3)
 #define SS_PIN BIT1
 
-#define EEPROM_PAGE_SIZE 64
+// Status register bits
+#define STATUS_WIP BIT0
+#define STATUS_BP0 BIT2
+#define STATUS_BP1 BIT3
+#define STATUS_WPEN BIT7
+#define STATUS_BP_SHIFT 2
+
+#define EEPROM_WRITE_RETRIES 2 // rewrites of a page before remapping it
+
+// Reserved region at the bottom of the device: the remap table page, write
+// counter pages, spare pages, system pages, then the logical pages
+#define REMAP_TABLE_ADDRESS 0
+#define COUNTER_FIRST_PAGE 1
+#define SPARE_FIRST_PAGE (COUNTER_FIRST_PAGE + EEPROM_COUNTER_PAGES)
+#define SYSTEM_FIRST_PAGE (SPARE_FIRST_PAGE + EEPROM_SPARE_PAGES)
+#define DATA_FIRST_PAGE (SYSTEM_FIRST_PAGE + EEPROM_SYSTEM_PAGES)
+#define REMAP_TABLE_MAGIC_0 0xA5
+#define REMAP_TABLE_MAGIC_1 0x5A
+#define REMAP_TABLE_HEADER_SIZE 2
+#define SPARE_FREE 0xFF // above any logical page
+#define SPARE_DEAD 0xFE // spare that failed verification itself
+
+// Write counters are persisted as 16-bit values in units of
+// COUNTER_UNIT programs, rounded up, so a checkpoint is needed at most
+// once every COUNTER_UNIT programs of a page.
+#define COUNTER_UNIT 64
+#define COUNTERS_PER_PAGE (EEPROM_PAGE_SIZE / 2)
 
 // Private function declarations
 
-static void EcrirePageEEPROM(unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source);
+static char VerifierEcriture(unsigned int AdresseEEPROM, unsigned int NbreOctets);
+static char EcrirePageVerifieeEEPROM(unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source);
+static char RemapperPageEEPROM(unsigned int page, unsigned int offset, unsigned int NbreOctets, unsigned char *Source);
+static char SauvegarderTableRemap();
+static void ChargerTableRemap();
+static void ChargerCompteurs();
+static void SauvegarderCompteurs();
+static unsigned int physicalPage(unsigned int page);
+// byte loops run from SRAM, clear of flash wait states when the clock changes
+RAMFUNC static void LirePhysiqueEEPROM(unsigned int AdressePhysique, unsigned int NbreOctets, unsigned char *Destination);
+static int VerifierPhysiqueEEPROM(unsigned int AdressePhysique, unsigned int NbreOctets, const unsigned char *Attendu);
+RAMFUNC static void EcrirePageEEPROM(unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source);
 static unsigned int ReadStatusRegister();
+static char EcrireRegistreStatut(unsigned int value);
+static int isProtected(unsigned int AdressePhysique);
+static void updateBaudRate();
 static int IsWriteInProgress();
-static void startSPIcommunication();
-static void endSPIcommunication();
-static int transmitWord(unsigned int byte);
-static unsigned int receiveWord();
+static void AttendreFinEcriture();
+// called for every byte from the loops above, in SRAM as well; only the
+// chip select delay of endSPIcommunication() runs from flash, once per command
+RAMFUNC static void startSPIcommunication();
+RAMFUNC static void endSPIcommunication();
+RAMFUNC static void transmitWord(unsigned int byte);
+RAMFUNC static unsigned int receiveWord();
 
 // Private static variable definitions
 
 static int initialized = 0;
 
+// logical page held by each spare page, or SPARE_FREE / SPARE_DEAD
+CCMRAM_BSS static unsigned char remapTable[EEPROM_SPARE_PAGES];
+
+static EepromStats stats;
+
+// status register as last read or written, gives the protected range
+// without SPI traffic
+static unsigned int statusRegister = 0;
+
+// page programs of each physical page, and counter pages to checkpoint
+CCMRAM_BSS static unsigned int pageWriteCounts[EEPROM_PAGE_COUNT];
+static unsigned int dirtyCounterPages = 0;
+
 // Function definitions
 
 void initEEPROM()
@@ -52,9 +116,11 @@ void initEEPROM()
 	// SPI-specific config
 
 	SPI2->CR2 |= BIT2; // SS output enabled
-	SPI2->CR1 |= BIT2 // Master mode
-	          | 0b111 << 3 // Baud rate control (f_PCLK/256) TODO: find optimal baud rate
-	          ;
+	SPI2->CR1 |= BIT2; // Master mode
+
+	// Baud rate control, follows APB1 clock changes
+	updateBaudRate();
+	clockRegisterListener(updateBaudRate);
 
 
 	NVIC->ISER[1] |= BIT3; // SPI global interrupt (bit 35)
@@ -83,6 +149,11 @@ void initEEPROM()
 	// Slave select disabled
 	GPIOA->ODR |= SS_PIN;
 
+	AttendreFinEcriture();
+	statusRegister = ReadStatusRegister();
+
+	ChargerTableRemap();
+
 	initialized = 1;
 }
 
@@ -91,40 +162,37 @@ char LireMemoireEEPROM (unsigned int AdresseEEPROM, unsigned int NbreOctets, uns
 	if (!initialized) {
 		return 1;
 	}
-	if (AdresseEEPROM >= EEPROM_MAX_ADDRESS) {
+	if (AdresseEEPROM >= EEPROM_MAX_ADDRESS || NbreOctets > EEPROM_MAX_ADDRESS - AdresseEEPROM) {
 		return 1;
 	}
 
-	while (IsWriteInProgress());
+	AttendreFinEcriture();
 
-	for (unsigned int i = 0; i < NbreOctets; i++) {
-		startSPIcommunication();
-
-		// send command to read word
-		transmitWord(0b00000011);
+	unsigned int maxAddressToRead = AdresseEEPROM + NbreOctets;
+	unsigned int currentAddress = AdresseEEPROM;
 
-		// send address
-		transmitWord(((AdresseEEPROM + i) & 0xFF00) >> 8);
-		transmitWord((AdresseEEPROM + i) & 0xFF);
+	// read each page individually, a remapped page is not contiguous
+	// with its neighbours
+	while (currentAddress < maxAddressToRead) {
+		unsigned int page = currentAddress / EEPROM_PAGE_SIZE;
+		unsigned int offset = currentAddress % EEPROM_PAGE_SIZE;
+		unsigned int bytesToRead = EEPROM_PAGE_SIZE - offset;
+		if (maxAddressToRead - currentAddress < bytesToRead) {
+			bytesToRead = maxAddressToRead - currentAddress;
+		}
 
-		// read data
-		transmitWord(0xFF);
-		volatile unsigned int x = receiveWord();
-		Destination[i] = receiveWord();
+		LirePhysiqueEEPROM(physicalPage(page) * EEPROM_PAGE_SIZE + offset, bytesToRead,
+				&Destination[currentAddress - AdresseEEPROM]);
 
-		endSPIcommunication();
+		currentAddress += bytesToRead;
 	}
 
-
 	return 0;
 }
 
 char EcrireMemoireEEPROM (unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source)
 {
-	if (!initialized) {
-		return 1;
-	}
-	if (AdresseEEPROM >= EEPROM_MAX_ADDRESS) {
+	if (VerifierEcriture(AdresseEEPROM, NbreOctets)) {
 		return 1;
 	}
 
@@ -137,26 +205,576 @@ char EcrireMemoireEEPROM (unsigned int AdresseEEPROM, unsigned int NbreOctets, u
 
 	// write each page individually
 	while (currentAddress < maxAddressToWrite) {
-		unsigned int bytesToWrite;
-		if (maxAddressToWrite - currentAddress < EEPROM_PAGE_SIZE) {
+		// never cross a page boundary, the device would wrap around
+		// to the start of the page
+		unsigned int bytesToWrite = (currentPage + 1) * EEPROM_PAGE_SIZE - currentAddress;
+		if (maxAddressToWrite - currentAddress < bytesToWrite) {
 			bytesToWrite = maxAddressToWrite - currentAddress;
-		} else if ((currentPage + 1) * EEPROM_PAGE_SIZE - currentAddress < EEPROM_PAGE_SIZE) {
-			bytesToWrite = (currentPage + 1) * EEPROM_PAGE_SIZE - currentAddress;
-		} else {
-			bytesToWrite = EEPROM_PAGE_SIZE;
 		}
 
 		// write
-		EcrirePageEEPROM(currentAddress, bytesToWrite, &Source[currentAddress - AdresseEEPROM]);
+		if (EcrirePageVerifieeEEPROM(currentAddress, bytesToWrite, &Source[currentAddress - AdresseEEPROM])) {
+			SauvegarderCompteurs();
+			return 1;
+		}
 
 		i++;
 		currentPage++;
 		currentAddress = currentPage * EEPROM_PAGE_SIZE;
 	}
 
+	SauvegarderCompteurs();
+
+	return 0;
+}
+
+/**
+ * Prepares a write performed by eepromWriteAsync(). Returns 1, and the
+ * write must not be run, when the range is invalid or protected.
+ */
+char eepromWriteAsyncStart(EepromAsyncWrite *write, unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source)
+{
+	PT_INIT(&write->pt);
+	write->address = AdresseEEPROM;
+	write->length = NbreOctets;
+	write->source = Source;
+	write->done = 0;
+	write->result = 0;
+
+	return VerifierEcriture(AdresseEEPROM, NbreOctets);
+}
+
+/**
+ * Same sequence as EcrireMemoireEEPROM(), page by page: WREN and WRITE,
+ * poll WIP, read back. Returns PT_WAITING while a write cycle runs instead
+ * of busy waiting; call it again until it returns PT_ENDED, then result
+ * holds the outcome. Remapping a page and the counter checkpoint still
+ * wait for their write cycles. The write fails when the device is still
+ * busy EEPROM_WRITE_TIMEOUT_US after the previous cycle.
+ *
+ * Only one write at a time, and not concurrently with the other
+ * functions of this file: they share the SPI bus.
+ */
+PtStatus eepromWriteAsync(EepromAsyncWrite *write)
+{
+	PT_BEGIN(&write->pt);
+
+	while (write->done < write->length) {
+		// never cross a page boundary
+		write->chunk = EEPROM_PAGE_SIZE - (write->address + write->done) % EEPROM_PAGE_SIZE;
+		if (write->chunk > write->length - write->done) {
+			write->chunk = write->length - write->done;
+		}
+
+		for (write->attempt = 0; write->attempt <= EEPROM_WRITE_RETRIES; write->attempt++) {
+			unsigned int address = write->address + write->done;
+			write->physicalAddress = physicalPage(address / EEPROM_PAGE_SIZE) * EEPROM_PAGE_SIZE + address % EEPROM_PAGE_SIZE;
+
+			if (write->attempt > 0) {
+				stats.retries++;
+			}
+
+			// a cycle still running after a timeout would ignore the write
+			timeoutStart(&write->timeout, EEPROM_WRITE_TIMEOUT_US);
+			PT_WAIT_UNTIL(&write->pt, !IsWriteInProgress() || timeoutExpired(&write->timeout));
+			if (IsWriteInProgress()) {
+				stats.timeouts++;
+				write->result = 1;
+				break;
+			}
+
+			EcrirePageEEPROM(write->physicalAddress, write->chunk, &write->source[write->done]);
+
+			timeoutStart(&write->timeout, EEPROM_WRITE_TIMEOUT_US);
+			PT_WAIT_UNTIL(&write->pt, !IsWriteInProgress() || timeoutExpired(&write->timeout));
+			if (IsWriteInProgress()) {
+				stats.timeouts++;
+			}
+			itmEvent(ITM_EVENT_EEPROM_READY, write->physicalAddress);
+
+			if (VerifierPhysiqueEEPROM(write->physicalAddress, write->chunk, &write->source[write->done])) {
+				break;
+			}
+
+			stats.verifyFailures++;
+		}
+
+		// the device stays busy, remapping would not get through either
+		if (write->result) {
+			break;
+		}
+
+		if (write->attempt > EEPROM_WRITE_RETRIES) {
+			unsigned int address = write->address + write->done;
+			if (RemapperPageEEPROM(address / EEPROM_PAGE_SIZE, address % EEPROM_PAGE_SIZE, write->chunk, &write->source[write->done])) {
+				write->result = 1;
+				break;
+			}
+		}
+
+		write->done += write->chunk;
+	}
+
+	SauvegarderCompteurs();
+
+	PT_END(&write->pt);
+}
+
+/**
+ * Reads from the system pages, offset 0 to EEPROM_SYSTEM_SIZE.
+ */
+char eepromReadSystem(unsigned int offset, unsigned int NbreOctets, unsigned char *Destination)
+{
+	if (!initialized || offset > EEPROM_SYSTEM_SIZE || NbreOctets > EEPROM_SYSTEM_SIZE - offset) {
+		return 1;
+	}
+
+	LirePhysiqueEEPROM(SYSTEM_FIRST_PAGE * EEPROM_PAGE_SIZE + offset, NbreOctets, Destination);
+	return 0;
+}
+
+/**
+ * Writes to the system pages and reads back. They are not remapped: a
+ * failing page returns 1.
+ */
+char eepromWriteSystem(unsigned int offset, unsigned int NbreOctets, unsigned char *Source)
+{
+	if (!initialized || offset > EEPROM_SYSTEM_SIZE || NbreOctets > EEPROM_SYSTEM_SIZE - offset) {
+		return 1;
+	}
+
+	unsigned int address = SYSTEM_FIRST_PAGE * EEPROM_PAGE_SIZE + offset;
+	unsigned int end = address + NbreOctets;
+	char result = 0;
+
+	for (unsigned int page = address / EEPROM_PAGE_SIZE; page * EEPROM_PAGE_SIZE < end; page++) {
+		if (isProtected(page * EEPROM_PAGE_SIZE)) {
+			stats.protectedWrites++;
+			return 1;
+		}
+	}
+
+	while (address < end && result == 0) {
+		unsigned int bytesToWrite = EEPROM_PAGE_SIZE - address % EEPROM_PAGE_SIZE;
+		if (bytesToWrite > end - address) {
+			bytesToWrite = end - address;
+		}
+
+		EcrirePageEEPROM(address, bytesToWrite, Source);
+		AttendreFinEcriture();
+		itmEvent(ITM_EVENT_EEPROM_READY, address);
+
+		if (!VerifierPhysiqueEEPROM(address, bytesToWrite, Source)) {
+			stats.verifyFailures++;
+			result = 1;
+		}
+
+		address += bytesToWrite;
+		Source += bytesToWrite;
+	}
+
+	SauvegarderCompteurs();
+
+	return result;
+}
+
+void eepromGetStats(EepromStats *statistics)
+{
+	*statistics = stats;
+
+	statistics->remappedPages = 0;
+	statistics->sparePagesLeft = 0;
+	for (unsigned int i = 0; i < EEPROM_SPARE_PAGES; i++) {
+		if (remapTable[i] == SPARE_FREE) {
+			statistics->sparePagesLeft++;
+		} else if (remapTable[i] != SPARE_DEAD) {
+			statistics->remappedPages++;
+		}
+	}
+}
+
+/**
+ * Sets the block protection bits (BP1:BP0) of the status register.
+ *
+ * Protection covers the upper part of the physical device, logical pages
+ * only: EEPROM_PROTECT_ALL would also freeze the reserved region
+ * (remapping, write counters, fault log) and is refused.
+ */
+char eepromSetProtection(EepromProtection protection)
+{
+	if (!initialized || protection == EEPROM_PROTECT_ALL) {
+		return 1;
+	}
+
+	unsigned int value = (statusRegister & STATUS_WPEN) | ((protection << STATUS_BP_SHIFT) & (STATUS_BP1 | STATUS_BP0));
+
+	return EcrireRegistreStatut(value);
+}
+
+EepromProtection eepromGetProtection()
+{
+	return (EepromProtection) ((statusRegister & (STATUS_BP1 | STATUS_BP0)) >> STATUS_BP_SHIFT);
+}
+
+/**
+ * Sets WPEN. While the WP pin is held low, the status register, and thus
+ * the protected range, can no longer be changed.
+ */
+char eepromLockProtection()
+{
+	if (!initialized) {
+		return 1;
+	}
+
+	return EcrireRegistreStatut(statusRegister | STATUS_WPEN);
+}
+
+/**
+ * First physical address covered by the block protection, EEPROM_SIZE when
+ * nothing is protected.
+ */
+unsigned int eepromProtectedStart()
+{
+	switch (eepromGetProtection()) {
+	case EEPROM_PROTECT_UPPER_QUARTER:
+		return EEPROM_SIZE - EEPROM_SIZE / 4;
+	case EEPROM_PROTECT_UPPER_HALF:
+		return EEPROM_SIZE / 2;
+	case EEPROM_PROTECT_ALL:
+		return 0;
+	default:
+		return EEPROM_SIZE;
+	}
+}
+
+/**
+ * Number of programs of a physical page since the device was formatted.
+ *
+ * Counters are restored rounded up to COUNTER_UNIT after a reset, so the
+ * value is an upper bound.
+ */
+unsigned int eepromGetPageWrites(unsigned int page)
+{
+	if (page >= EEPROM_PAGE_COUNT) {
+		return 0;
+	}
+
+	return pageWriteCounts[page];
+}
+
+/**
+ * Fills hotPages with the most programmed physical pages, most programmed
+ * first.
+ *
+ * Returns the number of entries filled.
+ */
+unsigned int eepromGetHotPages(EepromPageWear *hotPages, unsigned int count)
+{
+	unsigned int filled = 0;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	for (unsigned int page = 0; page < EEPROM_PAGE_COUNT; page++) {
+		unsigned int writes = pageWriteCounts[page];
+
+		if (writes == 0 || (filled == count && writes <= hotPages[filled - 1].writes)) {
+			continue;
+		}
+
+		// insertion in the sorted list, the last entry drops out when full
+		unsigned int i = filled < count ? filled++ : count - 1;
+		while (i > 0 && hotPages[i - 1].writes < writes) {
+			hotPages[i] = hotPages[i - 1];
+			i--;
+		}
+		hotPages[i].page = page;
+		hotPages[i].writes = writes;
+	}
+
+	return filled;
+}
+
+/**
+ * Writes the counter pages that changed since the last checkpoint.
+ */
+void eepromCheckpointCounters()
+{
+	if (initialized) {
+		SauvegarderCompteurs();
+	}
+}
+
+/**
+ * Checks a write before programming anything: the device silently ignores
+ * programs of protected pages, the whole write is rejected instead.
+ */
+static char VerifierEcriture(unsigned int AdresseEEPROM, unsigned int NbreOctets)
+{
+	if (!initialized) {
+		return 1;
+	}
+	if (AdresseEEPROM >= EEPROM_MAX_ADDRESS || NbreOctets > EEPROM_MAX_ADDRESS - AdresseEEPROM) {
+		return 1;
+	}
+
+	// a logical page is protected where it sits without remapping, its spare
+	// at the bottom of the device would not be
+	for (unsigned int page = AdresseEEPROM / EEPROM_PAGE_SIZE; page * EEPROM_PAGE_SIZE < AdresseEEPROM + NbreOctets; page++) {
+		if (isProtected((DATA_FIRST_PAGE + page) * EEPROM_PAGE_SIZE)
+				|| isProtected(physicalPage(page) * EEPROM_PAGE_SIZE)) {
+			stats.protectedWrites++;
+			return 1;
+		}
+	}
+
 	return 0;
 }
 
+/**
+ * Writes bytes of a logical page and reads them back.
+ *
+ * A page failing verification is rewritten up to EEPROM_WRITE_RETRIES
+ * times, then moved to a spare page.
+ */
+static char EcrirePageVerifieeEEPROM(unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source)
+{
+	unsigned int page = AdresseEEPROM / EEPROM_PAGE_SIZE;
+	unsigned int offset = AdresseEEPROM % EEPROM_PAGE_SIZE;
+
+	for (int attempt = 0; attempt <= EEPROM_WRITE_RETRIES; attempt++) {
+		unsigned int physicalAddress = physicalPage(page) * EEPROM_PAGE_SIZE + offset;
+
+		if (attempt > 0) {
+			stats.retries++;
+		}
+
+		EcrirePageEEPROM(physicalAddress, NbreOctets, Source);
+		AttendreFinEcriture();
+		itmEvent(ITM_EVENT_EEPROM_READY, physicalAddress);
+
+		if (VerifierPhysiqueEEPROM(physicalAddress, NbreOctets, Source)) {
+			return 0;
+		}
+
+		stats.verifyFailures++;
+	}
+
+	return RemapperPageEEPROM(page, offset, NbreOctets, Source);
+}
+
+/**
+ * Moves a failing logical page to a free spare page.
+ *
+ * The bytes of the page that are not being written are carried over from
+ * the failing page, then the remap table is persisted.
+ */
+static char RemapperPageEEPROM(unsigned int page, unsigned int offset, unsigned int NbreOctets, unsigned char *Source)
+{
+	unsigned char content[EEPROM_PAGE_SIZE];
+
+	if (isProtected(REMAP_TABLE_ADDRESS)) {
+		return 1;
+	}
+
+	LirePhysiqueEEPROM(physicalPage(page) * EEPROM_PAGE_SIZE, EEPROM_PAGE_SIZE, content);
+	for (unsigned int i = 0; i < NbreOctets; i++) {
+		content[offset + i] = Source[i];
+	}
+
+	for (unsigned int spare = 0; spare < EEPROM_SPARE_PAGES; spare++) {
+		if (remapTable[spare] != SPARE_FREE) {
+			continue;
+		}
+
+		unsigned int spareAddress = (SPARE_FIRST_PAGE + spare) * EEPROM_PAGE_SIZE;
+
+		EcrirePageEEPROM(spareAddress, EEPROM_PAGE_SIZE, content);
+		if (!VerifierPhysiqueEEPROM(spareAddress, EEPROM_PAGE_SIZE, content)) {
+			stats.verifyFailures++;
+			remapTable[spare] = SPARE_DEAD;
+			continue;
+		}
+
+		// a page that was already remapped leaves a failing spare behind
+		for (unsigned int i = 0; i < EEPROM_SPARE_PAGES; i++) {
+			if (remapTable[i] == page) {
+				remapTable[i] = SPARE_DEAD;
+			}
+		}
+		remapTable[spare] = page;
+		itmEvent(ITM_EVENT_EEPROM_REMAP, page);
+		LOG("EEPROM page %u remapped to spare %u", page, spare);
+
+		return SauvegarderTableRemap();
+	}
+
+	// out of spare pages
+	SauvegarderTableRemap();
+	return 1;
+}
+
+static void SauvegarderCompteurs()
+{
+	unsigned int dirty = dirtyCounterPages;
+	unsigned char content[EEPROM_PAGE_SIZE];
+
+	if (isProtected(COUNTER_FIRST_PAGE * EEPROM_PAGE_SIZE)) {
+		return; // kept dirty until protection is lifted
+	}
+
+	// counter pages written below may become dirty again, they are left
+	// for the next checkpoint
+	dirtyCounterPages = 0;
+
+	for (unsigned int counterPage = 0; counterPage < EEPROM_COUNTER_PAGES; counterPage++) {
+		if (!(dirty & (1 << counterPage))) {
+			continue;
+		}
+
+		for (unsigned int i = 0; i < COUNTERS_PER_PAGE; i++) {
+			unsigned int count = pageWriteCounts[counterPage * COUNTERS_PER_PAGE + i];
+			unsigned int units = (count + COUNTER_UNIT - 1) / COUNTER_UNIT;
+			if (units > 0xFFFE) {
+				units = 0xFFFE;
+			}
+			content[2 * i] = units & 0xFF;
+			content[2 * i + 1] = (units & 0xFF00) >> 8;
+		}
+
+		EcrirePageEEPROM((COUNTER_FIRST_PAGE + counterPage) * EEPROM_PAGE_SIZE, EEPROM_PAGE_SIZE, content);
+	}
+}
+
+static void ChargerCompteurs()
+{
+	unsigned char content[EEPROM_PAGE_SIZE];
+
+	for (unsigned int counterPage = 0; counterPage < EEPROM_COUNTER_PAGES; counterPage++) {
+		LirePhysiqueEEPROM((COUNTER_FIRST_PAGE + counterPage) * EEPROM_PAGE_SIZE, EEPROM_PAGE_SIZE, content);
+
+		for (unsigned int i = 0; i < COUNTERS_PER_PAGE; i++) {
+			unsigned int units = content[2 * i] | content[2 * i + 1] << 8;
+			if (units == 0xFFFF) {
+				units = 0; // erased
+			}
+			pageWriteCounts[counterPage * COUNTERS_PER_PAGE + i] = units * COUNTER_UNIT;
+		}
+	}
+}
+
+static char SauvegarderTableRemap()
+{
+	unsigned char table[REMAP_TABLE_HEADER_SIZE + EEPROM_SPARE_PAGES];
+
+	table[0] = REMAP_TABLE_MAGIC_0;
+	table[1] = REMAP_TABLE_MAGIC_1;
+	for (unsigned int i = 0; i < EEPROM_SPARE_PAGES; i++) {
+		table[REMAP_TABLE_HEADER_SIZE + i] = remapTable[i];
+	}
+
+	EcrirePageEEPROM(REMAP_TABLE_ADDRESS, sizeof(table), table);
+
+	return !VerifierPhysiqueEEPROM(REMAP_TABLE_ADDRESS, sizeof(table), table);
+}
+
+/**
+ * Loads the remap table and the write counters.
+ *
+ * A table page without the magic header (blank device, data written before
+ * the reserved region existed or while it sat at the top of the device)
+ * means the reserved region was never formatted: it starts with no
+ * remapping and zeroed counters, and is written once.
+ */
+static void ChargerTableRemap()
+{
+	unsigned char table[REMAP_TABLE_HEADER_SIZE + EEPROM_SPARE_PAGES];
+
+	AttendreFinEcriture();
+
+	LirePhysiqueEEPROM(REMAP_TABLE_ADDRESS, sizeof(table), table);
+
+	if (table[0] == REMAP_TABLE_MAGIC_0 && table[1] == REMAP_TABLE_MAGIC_1) {
+		for (unsigned int i = 0; i < EEPROM_SPARE_PAGES; i++) {
+			remapTable[i] = table[REMAP_TABLE_HEADER_SIZE + i];
+		}
+		ChargerCompteurs();
+		return;
+	}
+
+	for (unsigned int i = 0; i < EEPROM_SPARE_PAGES; i++) {
+		remapTable[i] = SPARE_FREE;
+	}
+	for (unsigned int page = 0; page < EEPROM_PAGE_COUNT; page++) {
+		pageWriteCounts[page] = 0;
+	}
+
+	if (isProtected(REMAP_TABLE_ADDRESS)) {
+		return;
+	}
+
+	dirtyCounterPages = (1 << EEPROM_COUNTER_PAGES) - 1;
+	SauvegarderCompteurs();
+	SauvegarderTableRemap();
+}
+
+static unsigned int physicalPage(unsigned int page)
+{
+	for (unsigned int i = 0; i < EEPROM_SPARE_PAGES; i++) {
+		if (remapTable[i] == page) {
+			return SPARE_FIRST_PAGE + i;
+		}
+	}
+
+	return DATA_FIRST_PAGE + page;
+}
+
+/**
+ * Sequential read of physical addresses, the range must not cross a page.
+ */
+static void LirePhysiqueEEPROM(unsigned int AdressePhysique, unsigned int NbreOctets, unsigned char *Destination)
+{
+	startSPIcommunication();
+
+	// send READ instruction
+	transmitWord(0b00000011);
+
+	// send address
+	transmitWord((AdressePhysique & 0xFF00) >> 8);
+	transmitWord(AdressePhysique & 0xFF);
+
+	// the device keeps shifting out the following bytes
+	for (unsigned int i = 0; i < NbreOctets; i++) {
+		transmitWord(0xFF);
+		Destination[i] = receiveWord();
+	}
+
+	endSPIcommunication();
+}
+
+/**
+ * Reads back physical addresses once the write cycle is over.
+ *
+ * Returns 1 when the content matches.
+ */
+static int VerifierPhysiqueEEPROM(unsigned int AdressePhysique, unsigned int NbreOctets, const unsigned char *Attendu)
+{
+	unsigned char lu[EEPROM_PAGE_SIZE];
+
+	AttendreFinEcriture();
+
+	LirePhysiqueEEPROM(AdressePhysique, NbreOctets, lu);
+
+	for (unsigned int i = 0; i < NbreOctets; i++) {
+		if (lu[i] != Attendu[i]) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 /**
  * Function responsible for writing a page to the EEPROM.
  *
@@ -165,7 +783,8 @@ char EcrireMemoireEEPROM (unsigned int AdresseEEPROM, unsigned int NbreOctets, u
  */
 static void EcrirePageEEPROM(unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source)
 {
-	while (IsWriteInProgress());
+	AttendreFinEcriture();
+	itmEvent(ITM_EVENT_EEPROM_PROGRAM, AdresseEEPROM);
 
 	/*
 	 * WRITE ENABLE
@@ -197,6 +816,14 @@ static void EcrirePageEEPROM(unsigned int AdresseEEPROM, unsigned int NbreOctets
 
 	endSPIcommunication();
 
+	stats.pageWrites++;
+
+	// a checkpoint is due each time the rounded up persisted value grows
+	unsigned int page = AdresseEEPROM / EEPROM_PAGE_SIZE;
+	if (++pageWriteCounts[page] % COUNTER_UNIT == 1) {
+		dirtyCounterPages |= 1 << (page / COUNTERS_PER_PAGE);
+	}
+
 	/*
 	 * WRITE DISABLE
 	 */
@@ -221,28 +848,93 @@ static unsigned int ReadStatusRegister()
 	return statusRegisterValue;
 }
 
+/**
+ * WRITE STATUS REGISTER, then reads it back since the device ignores the
+ * write when WPEN is set and the WP pin is low.
+ */
+static char EcrireRegistreStatut(unsigned int value)
+{
+	AttendreFinEcriture();
+
+	startSPIcommunication();
+	transmitWord(0b00000110); // WREN
+	endSPIcommunication();
+
+	startSPIcommunication();
+	transmitWord(0b00000001); // WRSR
+	transmitWord(value);
+	endSPIcommunication();
+
+	AttendreFinEcriture();
+
+	statusRegister = ReadStatusRegister();
+
+	return (statusRegister & (STATUS_WPEN | STATUS_BP1 | STATUS_BP0)) != value;
+}
+
+/**
+ * Picks the fastest SPI clock (f_PCLK / 2 to f_PCLK / 256) that does not
+ * exceed EEPROM_SPI_MAX_FREQUENCY. SPI2 is on APB1.
+ *
+ * Only called between transactions, while SPI is disabled.
+ */
+static void updateBaudRate()
+{
+	unsigned int pclk = clockGetPCLK1();
+	unsigned int br = 0;
+
+	while (br < 7 && (pclk >> (br + 1)) > EEPROM_SPI_MAX_FREQUENCY) {
+		br++;
+	}
+
+	SPI2->CR1 = (SPI2->CR1 & ~SPI_BR_MASK) | br << 3;
+}
+
+static int isProtected(unsigned int AdressePhysique)
+{
+	return AdressePhysique >= eepromProtectedStart();
+}
+
+/**
+ * Waits for the end of the write cycle (5 ms at most on the 25LC128).
+ * Gives up after EEPROM_WRITE_TIMEOUT_US, the following read back then
+ * fails verification.
+ */
+static void AttendreFinEcriture()
+{
+	Timeout timeout;
+
+	timeoutStart(&timeout, EEPROM_WRITE_TIMEOUT_US);
+	while (IsWriteInProgress()) {
+		if (timeoutExpired(&timeout)) {
+			stats.timeouts++;
+			return;
+		}
+	}
+}
+
 static int IsWriteInProgress()
 {
-	return ReadStatusRegister() & BIT0;
+	return ReadStatusRegister() & STATUS_WIP;
 }
 
-inline static int transmitWord(unsigned int byte)
+static void transmitWord(unsigned int byte)
 {
 	while (!(SPI2->SR & TXE_FLAG)) {}
 	SPI2->DR = 0xFF & byte;
 	while (!(SPI2->SR & TXE_FLAG)) {}
 	while (!(SPI2->SR & RXNE_FLAG)) {}
-	volatile unsigned int x = SPI2->DR;
+	(void) SPI2->DR; // clears RXNE
 }
 
-inline static void startSPIcommunication()
+static void startSPIcommunication()
 {
 	SPI2->CR1 |= BIT6; // SPI enabled
 	while (!(SPI2->SR & TXE_FLAG)) {}
 	GPIOA->ODR &= ~SS_PIN;
 }
 
-inline static void endSPIcommunication()
+static void endSPIcommunication()
 {
 	while ((SPI2->SR & BSY_FLAG)) {}
 
@@ -250,10 +942,10 @@ inline static void endSPIcommunication()
 
 	SPI2->CR1 &= ~BIT6; // SPI disabled
 
-	for (volatile int i = 0; i < EEPROM_DELAY_TICKS; i++); // at least 50 ns
+	timebaseDelayNs(EEPROM_CS_DISABLE_NS);
 }
 
-inline static unsigned int receiveWord()
+static unsigned int receiveWord()
 {
 	return SPI2->DR;
 }
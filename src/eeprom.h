@@ -8,10 +8,90 @@
 #ifndef EEPROM_H_
 #define EEPROM_H_
 
-#define EEPROM_MAX_ADDRESS 0x4000 // max address excluded
+#include "pt.h"
+#include "timebase.h"
+
+#define EEPROM_SIZE 0x4000
+#define EEPROM_PAGE_SIZE 64
+#define EEPROM_PAGE_COUNT (EEPROM_SIZE / EEPROM_PAGE_SIZE)
+
+// Pages failing verification are remapped to spare pages. The remap table
+// page, the per-page write counters (16 bits each), the spares and the
+// system pages, which hold records of the firmware itself (fault log), are
+// reserved at the bottom of the device; logical address 0 follows them.
+// Block protection covers the top of the device, so it can protect logical
+// data without suspending remapping, counters or the fault log.
+#define EEPROM_SPARE_PAGES 7
+#define EEPROM_COUNTER_PAGES (EEPROM_PAGE_COUNT * 2 / EEPROM_PAGE_SIZE)
+#define EEPROM_SYSTEM_PAGES 4
+#define EEPROM_SYSTEM_SIZE (EEPROM_SYSTEM_PAGES * EEPROM_PAGE_SIZE)
+#define EEPROM_RESERVED_PAGES (EEPROM_SYSTEM_PAGES + EEPROM_SPARE_PAGES + EEPROM_COUNTER_PAGES + 1)
+
+#define EEPROM_MAX_ADDRESS (EEPROM_SIZE - EEPROM_RESERVED_PAGES * EEPROM_PAGE_SIZE) // max address excluded
+
+typedef struct {
+	unsigned int pageWrites;     // page programs issued, retries included
+	unsigned int verifyFailures; // page programs that did not read back
+	unsigned int retries;
+	unsigned int remappedPages;  // logical pages living in a spare page
+	unsigned int sparePagesLeft;
+	unsigned int protectedWrites; // writes rejected by the block protection
+	unsigned int timeouts;       // write cycles still busy after EEPROM_WRITE_TIMEOUT_US
+} EepromStats;
+
+// Block protection, always covers the upper part of the physical device
+typedef enum {
+	EEPROM_PROTECT_NONE = 0,
+	EEPROM_PROTECT_UPPER_QUARTER = 1, // 0x3000 to 0x3FFF, logical from EEPROM_MAX_ADDRESS - 0x1000
+	EEPROM_PROTECT_UPPER_HALF = 2,    // 0x2000 to 0x3FFF, logical from EEPROM_MAX_ADDRESS - 0x2000
+	EEPROM_PROTECT_ALL = 3            // covers the reserved pages, refused by eepromSetProtection()
+} EepromProtection;
+
+typedef struct {
+	unsigned int page; // physical page
+	unsigned int writes;
+} EepromPageWear;
+
+/*
+ * Write in progress of eepromWriteAsync(), for instance polled from a
+ * scheduler task rearming a one-shot timer:
+ *
+ *   static void eepromHandler(const SchedEvent *event)
+ *   {
+ *       if (eepromWriteAsync(&write) == PT_WAITING) {
+ *           timerStart(&pollTimer, 1, 0); // posts to eepromTask
+ *       } else if (write.result) {
+ *           ...
+ *       }
+ *   }
+ */
+typedef struct {
+	Pt pt;
+	unsigned int address;
+	unsigned int length;
+	unsigned char *source;
+	unsigned int done;            // bytes written and verified
+	unsigned int chunk;           // bytes of the current page
+	unsigned int physicalAddress;
+	int attempt;
+	Timeout timeout;
+	char result;                  // 0 written, 1 failed, once ended
+} EepromAsyncWrite;
 
 void initEEPROM();
 char LireMemoireEEPROM (unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Destination);
 char EcrireMemoireEEPROM (unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source);
+char eepromWriteAsyncStart(EepromAsyncWrite *write, unsigned int AdresseEEPROM, unsigned int NbreOctets, unsigned char *Source);
+PtStatus eepromWriteAsync(EepromAsyncWrite *write);
+char eepromReadSystem(unsigned int offset, unsigned int NbreOctets, unsigned char *Destination);
+char eepromWriteSystem(unsigned int offset, unsigned int NbreOctets, unsigned char *Source);
+void eepromGetStats(EepromStats *statistics);
+unsigned int eepromGetPageWrites(unsigned int page);
+unsigned int eepromGetHotPages(EepromPageWear *hotPages, unsigned int count);
+void eepromCheckpointCounters();
+char eepromSetProtection(EepromProtection protection);
+EepromProtection eepromGetProtection();
+char eepromLockProtection();
+unsigned int eepromProtectedStart();
 
 #endif /* EEPROM_H_ */
@@ -0,0 +1,88 @@
+/*
+ * eeprom_record.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "eeprom_record.h"
+
+#define MAX_FIELD_SIZE 8 // largest scalar type (uint64_t, double)
+
+/**
+ * Encodes a single field and writes it at its address in the record.
+ */
+char eepromRecordStoreField(unsigned int AdresseEEPROM, const void *field, unsigned int size)
+{
+	unsigned char buffer[MAX_FIELD_SIZE];
+
+	if (size > MAX_FIELD_SIZE) {
+		return 1;
+	}
+
+	eepromRecordPut(buffer, field, size);
+
+	return EcrireMemoireEEPROM(AdresseEEPROM, size, buffer);
+}
+
+/**
+ * Writes the bytes of data that differ from previous.
+ *
+ * Within each EEPROM page, the span from the first to the last changed byte
+ * is written with a single page program, so every page is programmed at
+ * most once and untouched pages are not programmed at all.
+ */
+char eepromRecordWriteDelta(unsigned int AdresseEEPROM, unsigned char *data, const unsigned char *previous, unsigned int size)
+{
+	unsigned int offset = 0;
+
+	while (offset < size) {
+		// bytes of the record in the current page
+		unsigned int pageEnd = ((AdresseEEPROM + offset) / EEPROM_PAGE_SIZE + 1) * EEPROM_PAGE_SIZE - AdresseEEPROM;
+		if (pageEnd > size) {
+			pageEnd = size;
+		}
+
+		unsigned int first = offset;
+		while (first < pageEnd && data[first] == previous[first]) {
+			first++;
+		}
+
+		if (first < pageEnd) {
+			unsigned int last = pageEnd - 1;
+			while (data[last] == previous[last]) {
+				last--;
+			}
+
+			if (EcrireMemoireEEPROM(AdresseEEPROM + first, last - first + 1, &data[first])) {
+				return 1;
+			}
+		}
+
+		offset = pageEnd;
+	}
+
+	return 0;
+}
+
+/**
+ * Upgrades the next record of the list to its current layout.
+ *
+ * Meant to be called from the idle loop (a deferred timer, see
+ * eeprom_record.h) so that boot never waits on the migration of records
+ * that have not been accessed yet; the caller wires it.
+ *
+ * Returns 1 while records remain, 0 once the whole list has been visited.
+ */
+char eepromRecordMigrateStep(EepromRecordMigration *migration)
+{
+	if (migration->next >= migration->count) {
+		return 0;
+	}
+
+	if (migration->records[migration->next]()) {
+		migration->failures++;
+	}
+	migration->next++;
+
+	return migration->next < migration->count;
+}
@@ -0,0 +1,233 @@
+/*
+ * eeprom_record.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Schema-driven serialization of structs persisted in the EEPROM.
+ *
+ * A record is described once by a field list macro. The macros below
+ * expand it into the C struct, a packed byte layout used to compute the
+ * encoded size and every field offset at compile time, and the
+ * encode/decode/load/store functions. The stored image is a version byte
+ * followed by each field in little-endian order, without any padding.
+ *
+ * Usage:
+ *
+ *   // header
+ *   #define SENSOR_CONFIG_FIELDS(FIELD) \
+ *       FIELD(gain, uint16_t) \
+ *       FIELD(offset, int32_t)
+ *
+ *   EEPROM_RECORD_DECLARE(SensorConfig, SENSOR_CONFIG_FIELDS, 0x0100, 1)
+ *
+ *   // source file
+ *   EEPROM_RECORD_DEFINE(SensorConfig, SENSOR_CONFIG_FIELDS, 0)
+ *
+ *   // only the bytes of "gain" are programmed
+ *   EEPROM_RECORD_STORE_FIELD(SensorConfig, &config, gain);
+ *
+ * Versioning:
+ *
+ * When a layout changes, bump its version and keep the previous layout
+ * declared under another name at the same address (the version stays part
+ * of each declaration). The migration function given to
+ * EEPROM_RECORD_DEFINE converts a record stored with an older version:
+ *
+ *   static char migrateSensorConfig(unsigned char storedVersion, SensorConfig *config)
+ *   {
+ *       SensorConfigV1 old;
+ *       if (storedVersion != 1 || SensorConfigV1_Load(&old)) {
+ *           return 1;
+ *       }
+ *       config->gain = old.gain;
+ *       config->offset = 0;
+ *       return 0;
+ *   }
+ *   EEPROM_RECORD_DEFINE(SensorConfig, SENSOR_CONFIG_FIELDS, migrateSensorConfig)
+ *
+ * Migration is lazy: nothing is converted at boot. The first Load of an
+ * old record migrates it and writes it back in the current layout. Records
+ * that are never loaded can be upgraded in the background, one per call,
+ * with eepromRecordMigrateStep(). Nothing calls it by itself, the
+ * application wires it, for instance to a deferred timer:
+ *
+ *   static const EepromRecordUpgrade upgrades[] = { SensorConfig_Upgrade };
+ *   static EepromRecordMigration migration = { upgrades, 1, 0, 0 };
+ *
+ *   static void migrate(void *arg) // TIMER_DEFERRED, periodic
+ *   {
+ *       if (!eepromRecordMigrateStep(&migration)) {
+ *           timerStop(&migrationTimer);
+ *       }
+ *   }
+ *
+ * Fields must be scalar types (integers, floats); arrays and nested structs
+ * would not be converted to the storage byte order.
+ */
+
+#ifndef EEPROM_RECORD_H_
+#define EEPROM_RECORD_H_
+
+#include <stddef.h>
+#include <string.h>
+#include "eeprom.h"
+
+#define EEPROM_RECORD_VERSION_ERASED 0xFF // blank EEPROM reads as 0xFF
+
+/*
+ * Field expanders
+ */
+
+#define EEPROM_RECORD_STRUCT_FIELD(name, type) type name;
+#define EEPROM_RECORD_LAYOUT_FIELD(name, type) unsigned char name[sizeof(type)];
+
+#define EEPROM_RECORD_ENCODE_FIELD(name, type) \
+	eepromRecordPut(&buffer[offsetof(layout_t, name)], &obj->name, sizeof(type));
+
+#define EEPROM_RECORD_DECODE_FIELD(name, type) \
+	eepromRecordGet(&obj->name, &buffer[offsetof(layout_t, name)], sizeof(type));
+
+/*
+ * Record declaration, goes in a header. Address is the EEPROM address of the
+ * version byte, version is the current layout version (1 to 254).
+ */
+
+#define EEPROM_RECORD_DECLARE(Name, FIELDS, address, version) \
+	typedef struct { FIELDS(EEPROM_RECORD_STRUCT_FIELD) } Name; \
+	typedef struct { unsigned char _version; FIELDS(EEPROM_RECORD_LAYOUT_FIELD) } Name##_layout; \
+	enum { \
+		Name##_ADDRESS = (address), \
+		Name##_VERSION = (version), \
+		Name##_ENCODED_SIZE = sizeof(Name##_layout) \
+	}; \
+	void Name##_Encode(const Name *obj, unsigned char *buffer); \
+	char Name##_Decode(Name *obj, const unsigned char *buffer); \
+	char Name##_Load(Name *obj); \
+	char Name##_Store(const Name *obj); \
+	char Name##_StoreDelta(const Name *obj, const Name *previous); \
+	char Name##_Upgrade(void);
+
+/*
+ * Record definition, goes in exactly one source file. Migrate is a
+ * char (*)(unsigned char storedVersion, Name *obj) returning 0 on success,
+ * or nonzero when older versions cannot be converted.
+ */
+
+#define EEPROM_RECORD_DEFINE(Name, FIELDS, migrate) \
+	void Name##_Encode(const Name *obj, unsigned char *buffer) \
+	{ \
+		typedef Name##_layout layout_t; \
+		buffer[0] = Name##_VERSION; \
+		FIELDS(EEPROM_RECORD_ENCODE_FIELD) \
+	} \
+	char Name##_Decode(Name *obj, const unsigned char *buffer) \
+	{ \
+		typedef Name##_layout layout_t; \
+		if (buffer[0] != Name##_VERSION) { \
+			return 1; \
+		} \
+		FIELDS(EEPROM_RECORD_DECODE_FIELD) \
+		return 0; \
+	} \
+	char Name##_Load(Name *obj) \
+	{ \
+		char (*const migrateFunction)(unsigned char, Name *) = (migrate); \
+		unsigned char buffer[Name##_ENCODED_SIZE]; \
+		if (LireMemoireEEPROM(Name##_ADDRESS, Name##_ENCODED_SIZE, buffer)) { \
+			return 1; \
+		} \
+		if (buffer[0] == Name##_VERSION) { \
+			return Name##_Decode(obj, buffer); \
+		} \
+		if (buffer[0] == 0 || buffer[0] > Name##_VERSION || migrateFunction == 0) { \
+			return 1; \
+		} \
+		if (migrateFunction(buffer[0], obj)) { \
+			return 1; \
+		} \
+		return Name##_Store(obj); \
+	} \
+	char Name##_Store(const Name *obj) \
+	{ \
+		unsigned char buffer[Name##_ENCODED_SIZE]; \
+		Name##_Encode(obj, buffer); \
+		return EcrireMemoireEEPROM(Name##_ADDRESS, Name##_ENCODED_SIZE, buffer); \
+	} \
+	char Name##_StoreDelta(const Name *obj, const Name *previous) \
+	{ \
+		unsigned char buffer[Name##_ENCODED_SIZE]; \
+		unsigned char previousBuffer[Name##_ENCODED_SIZE]; \
+		Name##_Encode(obj, buffer); \
+		Name##_Encode(previous, previousBuffer); \
+		return eepromRecordWriteDelta(Name##_ADDRESS, buffer, previousBuffer, Name##_ENCODED_SIZE); \
+	} \
+	char Name##_Upgrade(void) \
+	{ \
+		Name obj; \
+		unsigned char version; \
+		if (LireMemoireEEPROM(Name##_ADDRESS, 1, &version)) { \
+			return 1; \
+		} \
+		if (version == Name##_VERSION || version == EEPROM_RECORD_VERSION_ERASED) { \
+			return 0; \
+		} \
+		return Name##_Load(&obj); \
+	}
+
+/*
+ * Writes a single field of a record, only the pages holding that field are
+ * programmed.
+ */
+
+#define EEPROM_RECORD_STORE_FIELD(Name, obj, field) \
+	eepromRecordStoreField( \
+		Name##_ADDRESS + offsetof(Name##_layout, field), \
+		&(obj)->field, \
+		sizeof((obj)->field))
+
+/*
+ * Byte order helpers. The storage order is little-endian, which is also the
+ * core's order, so they reduce to a copy on this target.
+ */
+
+static inline void eepromRecordPut(unsigned char *destination, const void *source, unsigned int size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(destination, source, size);
+#else
+	for (unsigned int i = 0; i < size; i++) {
+		destination[i] = ((const unsigned char *) source)[size - 1 - i];
+	}
+#endif
+}
+
+static inline void eepromRecordGet(void *destination, const unsigned char *source, unsigned int size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(destination, source, size);
+#else
+	for (unsigned int i = 0; i < size; i++) {
+		((unsigned char *) destination)[i] = source[size - 1 - i];
+	}
+#endif
+}
+
+/*
+ * Background migration
+ */
+
+typedef char (*EepromRecordUpgrade)(void);
+
+typedef struct {
+	const EepromRecordUpgrade *records; // Name##_Upgrade of each record
+	unsigned int count;
+	unsigned int next;                  // index of the next record to upgrade
+	unsigned int failures;              // records that could not be migrated
+} EepromRecordMigration;
+
+char eepromRecordStoreField(unsigned int AdresseEEPROM, const void *field, unsigned int size);
+char eepromRecordWriteDelta(unsigned int AdresseEEPROM, unsigned char *data, const unsigned char *previous, unsigned int size);
+char eepromRecordMigrateStep(EepromRecordMigration *migration);
+
+#endif /* EEPROM_RECORD_H_ */
@@ -0,0 +1,192 @@
+/*
+ * fault.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include <stddef.h>
+#include "stm32f4xx.h"
+#include "fault.h"
+#include "eeprom.h"
+#include "timebase.h"
+#include "sections.h"
+#include "critical.h"
+
+#define FAULT_MAGIC 0xFA017EC0
+
+// exception frame sizes in words, without and with the FPU registers
+#define FRAME_WORDS 8
+#define FRAME_FPU_WORDS 26
+
+#define EXC_RETURN_NO_FPU 0x10 // bit 4 of EXC_RETURN clear: FPU frame
+#define XPSR_ALIGNED 0x200     // bit 9 of the stacked xPSR: padding word
+
+// the stack the fault happened on may be the cause, faultCapture() runs on its own
+#define FAULT_STACK_SIZE 256 // bytes
+
+CCMRAM_BSS uint64_t faultStack[FAULT_STACK_SIZE / 8];
+
+_Static_assert(sizeof(FaultRecord) <= EEPROM_SYSTEM_SIZE - FAULT_EEPROM_OFFSET, "fault record too large");
+
+// survives the reset that follows the capture
+NOINIT static FaultRecord pending;
+
+static uint32_t checksum(const FaultRecord *record)
+{
+	const uint32_t *words = (const uint32_t *) record;
+	uint32_t sum = 0;
+
+	for (unsigned int i = 0; i < offsetof(FaultRecord, checksum) / 4; i++) {
+		sum = (sum << 1 | sum >> 31) + words[i];
+	}
+	return ~sum;
+}
+
+static int isValid(const FaultRecord *record)
+{
+	return record->magic == FAULT_MAGIC && record->checksum == checksum(record);
+}
+
+// Words from address to end lie in RAM (CCM or SRAM)
+static int isInRam(uint32_t address, uint32_t end)
+{
+	return (address >= CCMDATARAM_BASE && end <= CCMDATARAM_BASE + 0x10000 && address < end)
+			|| (address >= SRAM1_BASE && end <= SRAM1_BASE + 0x20000 && address < end);
+}
+
+static void startRecord(uint32_t type)
+{
+	for (unsigned int i = 0; i < sizeof(pending) / 4; i++) {
+		((uint32_t *) &pending)[i] = 0;
+	}
+
+	pending.type = type;
+	pending.ticks = (uint32_t) timebaseGetTicks();
+}
+
+static void endRecord(void)
+{
+	pending.magic = FAULT_MAGIC;
+	pending.checksum = checksum(&pending);
+}
+
+/**
+ * Common entry of the fault handlers (type in r2). Picks the stack the
+ * exception frame was pushed on, then switches to faultStack in case the
+ * fault came from a stack overflow.
+ */
+__attribute__((naked)) void faultEntry(void)
+{
+	__asm volatile (
+		"tst lr, #4\n"
+		"ite eq\n"
+		"mrseq r0, msp\n"
+		"mrsne r0, psp\n"
+		"mov r1, lr\n"
+		"movw r3, #:lower16:(faultStack + " FAULT_STRING(FAULT_STACK_SIZE) ")\n"
+		"movt r3, #:upper16:(faultStack + " FAULT_STRING(FAULT_STACK_SIZE) ")\n"
+		"mov sp, r3\n"
+		"b faultCapture\n");
+}
+
+/**
+ * Records the fault in NOINIT RAM and resets. The frame and the stack are
+ * only read if they lie in RAM, a corrupted stack pointer leaves them zero.
+ */
+void faultCapture(const uint32_t *frame, uint32_t excReturn, uint32_t type)
+{
+	__disable_irq();
+
+	startRecord(type);
+	pending.cfsr = SCB->CFSR;
+	pending.hfsr = SCB->HFSR;
+	pending.mmfar = SCB->MMFAR;
+	pending.bfar = SCB->BFAR;
+	pending.excReturn = excReturn;
+
+	uint32_t frameAddress = (uint32_t) frame;
+	if (isInRam(frameAddress, frameAddress + FRAME_WORDS * 4)) {
+		pending.r0 = frame[0];
+		pending.r1 = frame[1];
+		pending.r2 = frame[2];
+		pending.r3 = frame[3];
+		pending.r12 = frame[4];
+		pending.lr = frame[5];
+		pending.pc = frame[6];
+		pending.xpsr = frame[7];
+
+		uint32_t sp = frameAddress + ((excReturn & EXC_RETURN_NO_FPU) ? FRAME_WORDS : FRAME_FPU_WORDS) * 4;
+		if (pending.xpsr & XPSR_ALIGNED) {
+			sp += 4;
+		}
+		pending.sp = sp;
+
+		for (unsigned int i = 0; i < FAULT_STACK_WORDS && isInRam(sp, sp + 4); i++, sp += 4) {
+			pending.stack[i] = *(const uint32_t *) sp;
+		}
+	} else {
+		pending.sp = frameAddress;
+	}
+
+	endRecord();
+
+	NVIC_SystemReset();
+	while (1) {
+	}
+}
+
+/**
+ * Records a fault detected by software, saved at the next boot, with the
+ * address of the caller in lr. The caller resets or lets the watchdog reset.
+ */
+void faultRecord(uint32_t type, uint32_t info)
+{
+	uint32_t primask = criticalEnter();
+
+	startRecord(type);
+	pending.lr = (uint32_t) __builtin_return_address(0);
+	pending.info = info;
+	endRecord();
+
+	criticalExit(primask);
+}
+
+/**
+ * Enables the configurable faults, then saves the record of a fault that
+ * caused the last reset to EEPROM. Call after initEEPROM().
+ */
+void faultInit(void)
+{
+	SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk | SCB_SHCSR_BUSFAULTENA_Msk | SCB_SHCSR_USGFAULTENA_Msk;
+	SCB->CCR |= SCB_CCR_DIV_0_TRP_Msk;
+
+	// a watchdog reset that nothing recorded, the supervisor did not run
+	if (RCC_GetFlagStatus(RCC_FLAG_IWDGRST) == SET && !isValid(&pending)) {
+		faultRecord(FAULT_WATCHDOG, FAULT_INFO_NONE);
+	}
+	RCC_ClearFlag();
+
+	if (!isValid(&pending)) {
+		return;
+	}
+
+	FaultRecord last;
+	pending.sequence = faultGetLastRecord(&last) ? 1 : last.sequence + 1;
+	pending.checksum = checksum(&pending);
+
+	// kept for the next boot if the write fails
+	if (eepromWriteSystem(FAULT_EEPROM_OFFSET, sizeof(pending), (unsigned char *) &pending) == 0) {
+		pending.magic = 0;
+	}
+}
+
+/**
+ * Reads the last saved record. Returns 1 if there is none.
+ */
+char faultGetLastRecord(FaultRecord *record)
+{
+	if (eepromReadSystem(FAULT_EEPROM_OFFSET, sizeof(*record), (unsigned char *) record)) {
+		return 1;
+	}
+	return isValid(record) ? 0 : 1;
+}
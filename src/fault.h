@@ -0,0 +1,76 @@
+/*
+ * fault.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Crash records of fault exceptions.
+ *
+ * The fault handlers of stm32f4xx_it.c pass the stacked exception frame
+ * to faultCapture(), which copies it with the fault status registers and
+ * the words above it on the faulting stack into a record kept in NOINIT
+ * RAM, then resets at once. On the next boot faultInit() finds the record,
+ * writes it to the EEPROM system pages and clears it; faultGetLastRecord()
+ * reads it back from there.
+ *
+ * Software detected faults are recorded with faultRecord() and saved the
+ * same way once the reset happened. A watchdog reset that nothing recorded
+ * is saved as FAULT_WATCHDOG with no client (FAULT_INFO_NONE).
+ *
+ * faultInit() also enables the MemManage, BusFault and UsageFault
+ * exceptions and the divide by zero trap, which would otherwise all end in
+ * a HardFault.
+ */
+
+#ifndef FAULT_H_
+#define FAULT_H_
+
+#include <stdint.h>
+
+// Types of records, numbers because the handler entry uses them in assembly
+#define FAULT_HARD 1
+#define FAULT_MEMMANAGE 2
+#define FAULT_BUS 3
+#define FAULT_USAGE 4
+#define FAULT_WATCHDOG 5          // info: index of the client that missed, see watchdog.h
+
+#define FAULT_INFO_NONE 0xFFFFFFFF
+
+#define FAULT_STACK_WORDS 16      // words saved above the exception frame
+#define FAULT_EEPROM_OFFSET 0     // in the EEPROM system pages
+
+typedef struct {
+	uint32_t magic;
+	uint32_t type;
+	uint32_t sequence;            // records saved since the EEPROM was blank
+	uint32_t ticks;               // timebase milliseconds at the fault
+	uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr;
+	uint32_t cfsr;
+	uint32_t hfsr;
+	uint32_t mmfar;
+	uint32_t bfar;
+	uint32_t excReturn;           // main or process stack, FPU frame
+	uint32_t sp;                  // before the exception
+	uint32_t info;                // type specific
+	uint32_t stack[FAULT_STACK_WORDS];
+	uint32_t checksum;
+} FaultRecord;
+
+/*
+ * Body of a fault handler, which must be naked so that lr still holds
+ * EXC_RETURN: branches to faultEntry() with the type in r2.
+ */
+#define FAULT_STRING_(x) #x
+#define FAULT_STRING(x) FAULT_STRING_(x)
+#define FAULT_ENTRY(type) \
+	__asm volatile ( \
+		"movs r2, #" FAULT_STRING(type) "\n" \
+		"b faultEntry\n")
+
+void faultInit(void);
+void faultEntry(void);
+void faultCapture(const uint32_t *frame, uint32_t excReturn, uint32_t type) __attribute__((noreturn));
+void faultRecord(uint32_t type, uint32_t info);
+char faultGetLastRecord(FaultRecord *record);
+
+#endif /* FAULT_H_ */
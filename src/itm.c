@@ -0,0 +1,98 @@
+/*
+ * itm.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stm32f4xx.h"
+#include "itm.h"
+#include "clock.h"
+
+#define ITM_UNLOCK 0xC5ACCE55
+#define ITM_TRACE_BUS_ID 1
+#define TPI_PROTOCOL_NRZ 2      // asynchronous SWO, UART encoding
+#define TPI_FFCR_TRIGIN 0x100   // formatter off, required for SWO
+
+// Private function declarations
+
+static void updatePrescaler(void);
+
+// Private static variable definitions
+
+static uint32_t baudRate = 0;
+
+// Function definitions
+
+/**
+ * Enables the ITM with local timestamps in CPU cycles, and stimulus port 0
+ * and the event ports.
+ *
+ * With swoBaudRate at 0 the debugger keeps ownership of the SWO pin setup
+ * (SWV settings of the launch configuration). Otherwise the TPIU is set
+ * for NRZ output at that rate, for a plain UART capture of PB3; the
+ * prescaler then follows clock level changes.
+ */
+void itmInit(uint32_t swoBaudRate)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+
+	if (swoBaudRate) {
+		baudRate = swoBaudRate;
+		DBGMCU->CR |= DBGMCU_CR_TRACE_IOEN; // TRACE_MODE 0: asynchronous
+		TPI->SPPR = TPI_PROTOCOL_NRZ;
+		TPI->FFCR = TPI_FFCR_TRIGIN;
+		updatePrescaler();
+		clockRegisterListener(updatePrescaler);
+	}
+
+	ITM->LAR = ITM_UNLOCK;
+	ITM->TCR = 0;
+	ITM->TCR = (ITM_TRACE_BUS_ID << ITM_TCR_TraceBusID_Pos)
+			| ITM_TCR_SYNCENA_Msk
+			| ITM_TCR_TSENA_Msk
+			| ITM_TCR_ITMENA_Msk;
+	ITM->TPR = 0; // ports usable from unprivileged code
+	ITM->TER = (1UL << ITM_PORT_TEXT)
+			| (1UL << ITM_EVENT_EEPROM_PROGRAM)
+			| (1UL << ITM_EVENT_EEPROM_READY)
+			| (1UL << ITM_EVENT_EEPROM_REMAP)
+			| (1UL << ITM_EVENT_CLOCK_CHANGE)
+			| (0xFFFFUL << ITM_EVENT_USER);
+}
+
+/**
+ * Sends text on stimulus port 0, four characters per 32-bit packet.
+ * Returns length, or 0 when the port is disabled.
+ */
+int itmWrite(const char *data, int length)
+{
+	int i = 0;
+
+	if (!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & (1UL << ITM_PORT_TEXT))) {
+		return 0;
+	}
+
+	for (; i + 4 <= length; i += 4) {
+		uint32_t word = (uint8_t) data[i]
+				| (uint8_t) data[i + 1] << 8
+				| (uint8_t) data[i + 2] << 16
+				| (uint32_t) (uint8_t) data[i + 3] << 24;
+		while (ITM->PORT[ITM_PORT_TEXT].u32 == 0);
+		ITM->PORT[ITM_PORT_TEXT].u32 = word;
+	}
+	for (; i < length; i++) {
+		while (ITM->PORT[ITM_PORT_TEXT].u32 == 0);
+		ITM->PORT[ITM_PORT_TEXT].u8 = (uint8_t) data[i];
+	}
+
+	return length;
+}
+
+/**
+ * SWO rate from the current HCLK. The trace clock is HCLK on this part.
+ */
+static void updatePrescaler(void)
+{
+	TPI->ACPR = clockGetHCLK() / baudRate - 1;
+	itmEvent(ITM_EVENT_CLOCK_CHANGE, clockGetHCLK());
+}
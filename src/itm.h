@@ -0,0 +1,47 @@
+/*
+ * itm.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * ITM trace output on the SWO pin (PB3).
+ *
+ * Stimulus port 0 carries text (printf when built with CONSOLE_ITM). Each
+ * event type has a stimulus port of its own and a 32-bit payload; the ITM
+ * adds a local timestamp packet in CPU cycles, so an event costs a single
+ * store. tools/swo_decode.py turns a capture into a timeline, its event
+ * table must follow ItmEvent.
+ */
+
+#ifndef ITM_H_
+#define ITM_H_
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+#define ITM_PORT_TEXT 0
+
+typedef enum {
+	ITM_EVENT_EEPROM_PROGRAM = 1,  // page program started, physical address
+	ITM_EVENT_EEPROM_READY = 2,    // page program finished, physical address
+	ITM_EVENT_EEPROM_REMAP = 3,    // page moved to a spare, logical page
+	ITM_EVENT_CLOCK_CHANGE = 4,    // new HCLK in Hz
+	ITM_EVENT_USER = 16            // first port free for the application
+} ItmEvent;
+
+void itmInit(uint32_t swoBaudRate);
+int itmWrite(const char *data, int length);
+
+/**
+ * Sends a 32-bit event on its stimulus port. Does nothing when the port
+ * is not enabled (no debugger and no itmInit).
+ */
+static inline void itmEvent(ItmEvent event, uint32_t value)
+{
+	if ((ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1UL << event))) {
+		while (ITM->PORT[event].u32 == 0); // FIFO full
+		ITM->PORT[event].u32 = value;
+	}
+}
+
+#endif /* ITM_H_ */
@@ -0,0 +1,680 @@
+/*
+ * kernel.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#ifdef USE_KERNEL
+
+#include <string.h>
+#include "stm32f4xx.h"
+#include "kernel.h"
+#include "stack.h"
+#include "critical.h"
+
+#define EXC_RETURN_THREAD_PSP 0xFFFFFFFD // thread mode, process stack, no FPU frame
+#define XPSR_THUMB 0x01000000
+#define CONTROL_FPCA (1 << 2)
+
+// Private function declarations
+
+void kernelSelect(void);
+static void taskExit(void);
+static void idleEntry(void *arg);
+static void timeoutCallback(void *arg);
+static void readyAppend(KernelTask *task);
+static void readyRemove(KernelTask *task);
+static void reschedule(void);
+static void waitInsert(KernelTask **list, KernelTask *task);
+static void waitRemove(KernelTask *task);
+static void block(KernelTask **list, uint32_t timeout);
+static void wake(KernelTask *task, uint8_t result);
+static void setPriority(KernelTask *task, uint8_t priority);
+static void updateInheritance(KernelTask *owner);
+
+// Private static variable definitions
+
+// running task, read by PendSV_Handler and SVC_Handler
+KernelTask *kernelCurrent = 0;
+
+// a FIFO per priority, and a bit per non-empty one
+static KernelTask *readyHead[KERNEL_MAX_PRIORITY + 1];
+static KernelTask *readyTail[KERNEL_MAX_PRIORITY + 1];
+static uint32_t readyMask = 0;
+
+static KernelStats stats;
+
+KERNEL_TASK_DEFINE(kernelIdleTask, idleEntry, 0, 0, KERNEL_IDLE_STACK_SIZE);
+
+// Function definitions
+
+/**
+ * Registers a task, it starts at its entry point with arg. May be called
+ * before kernelStart() or from a running task.
+ */
+char kernelAddTask(KernelTask *task)
+{
+	if (task->basePriority > KERNEL_MAX_PRIORITY || task->stackSize < 128) {
+		return 1;
+	}
+
+	uint32_t words = task->stackSize / 4;
+	for (uint32_t i = 0; i < words; i++) {
+		task->stack[i] = STACK_PAINT_PATTERN;
+	}
+
+	// exception frame as PendSV would leave it: r4-r11, EXC_RETURN, then
+	// r0-r3, r12, lr, pc, xPSR stacked by the core
+	uint32_t *sp = task->stack + words - 17;
+	memset(sp, 0, 17 * 4);
+	sp[8] = EXC_RETURN_THREAD_PSP;
+	sp[9] = (uint32_t) task->arg;
+	sp[14] = (uint32_t) taskExit;
+	sp[15] = (uint32_t) task->entry & ~1UL;
+	sp[16] = XPSR_THUMB;
+	task->sp = sp;
+
+	timerInit(&task->timer, timeoutCallback, task, TIMER_ISR);
+	task->priority = task->basePriority;
+	task->heldMutexes = 0;
+	task->waitList = 0;
+	task->waitMutex = 0;
+	task->state = KERNEL_TASK_READY;
+
+	uint32_t primask = criticalEnter();
+	readyAppend(task);
+	reschedule();
+	criticalExit(primask);
+
+	return 0;
+}
+
+/**
+ * Starts the highest priority task on its stack and hands the main stack
+ * over to interrupt handlers, from its top: the locals of main are lost.
+ * Does not return.
+ */
+void kernelStart(void)
+{
+	kernelAddTask(&kernelIdleTask);
+
+	NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+	FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+
+	__disable_irq();
+	kernelSelect();
+
+	// drop the FPU context of main, SVC must not reserve room for it
+	__set_CONTROL(__get_CONTROL() & ~CONTROL_FPCA);
+	__ISB();
+	__enable_irq();
+
+	__asm volatile ("svc 0");
+	while (1);
+}
+
+KernelTask *kernelCurrentTask(void)
+{
+	return kernelCurrent;
+}
+
+/**
+ * Lets the other ready tasks of the same priority run first.
+ */
+void kernelYield(void)
+{
+	uint32_t primask = criticalEnter();
+
+	readyRemove(kernelCurrent);
+	readyAppend(kernelCurrent);
+	reschedule();
+
+	criticalExit(primask);
+}
+
+/**
+ * Blocks the calling task for ticks milliseconds, 0 yields.
+ */
+void kernelSleep(uint32_t ticks)
+{
+	if (ticks == 0) {
+		kernelYield();
+		return;
+	}
+
+	uint32_t primask = criticalEnter();
+	block(0, ticks);
+	criticalExit(primask);
+}
+
+/**
+ * Bytes of the task stack never used, from its paint.
+ */
+uint32_t kernelGetStackFree(const KernelTask *task)
+{
+	uint32_t words = task->stackSize / 4;
+	uint32_t i = 0;
+
+	while (i < words && task->stack[i] == STACK_PAINT_PATTERN) {
+		i++;
+	}
+
+	return i * 4;
+}
+
+void kernelGetStats(KernelStats *statistics)
+{
+	*statistics = stats;
+	statistics->maxMaskedCycles = criticalGetMaxCycles();
+}
+
+/*
+ * Mutexes
+ */
+
+void kernelMutexInit(KernelMutex *mutex)
+{
+	mutex->owner = 0;
+	mutex->waiters = 0;
+	mutex->nextHeld = 0;
+}
+
+/**
+ * Locks the mutex, waiting at most timeout ticks. The owner inherits the
+ * priority of the caller meanwhile. Returns KERNEL_TIMEOUT, or 1 when the
+ * caller already owns it (mutexes are not recursive).
+ */
+char kernelMutexLock(KernelMutex *mutex, uint32_t timeout)
+{
+	uint32_t primask = criticalEnter();
+	KernelTask *task = kernelCurrent;
+
+	if (mutex->owner == 0) {
+		mutex->owner = task;
+		mutex->nextHeld = task->heldMutexes;
+		task->heldMutexes = mutex;
+		criticalExit(primask);
+		return KERNEL_OK;
+	}
+	if (mutex->owner == task) {
+		criticalExit(primask);
+		return 1;
+	}
+	if (timeout == 0) {
+		criticalExit(primask);
+		return KERNEL_TIMEOUT;
+	}
+
+	task->waitMutex = mutex;
+	block(&mutex->waiters, timeout);
+	updateInheritance(mutex->owner);
+	criticalExit(primask);
+
+	// unlock hands the mutex over before waking the task
+	return task->waitResult;
+}
+
+/**
+ * Unlocks the mutex, given to its highest priority waiter. The caller
+ * drops the priority inherited through it. Returns 1 when the caller is
+ * not the owner.
+ */
+char kernelMutexUnlock(KernelMutex *mutex)
+{
+	uint32_t primask = criticalEnter();
+	KernelTask *task = kernelCurrent;
+
+	if (mutex->owner != task) {
+		criticalExit(primask);
+		return 1;
+	}
+
+	KernelMutex **held = &task->heldMutexes;
+	while (*held != mutex) {
+		held = &(*held)->nextHeld;
+	}
+	*held = mutex->nextHeld;
+
+	KernelTask *next = mutex->waiters;
+	if (next) {
+		next->waitMutex = 0;
+		wake(next, KERNEL_OK);
+		mutex->owner = next;
+		mutex->nextHeld = next->heldMutexes;
+		next->heldMutexes = mutex;
+		updateInheritance(next);
+	} else {
+		mutex->owner = 0;
+	}
+
+	updateInheritance(task);
+	reschedule();
+	criticalExit(primask);
+
+	return 0;
+}
+
+/*
+ * Semaphores
+ */
+
+void kernelSemInit(KernelSemaphore *semaphore, uint32_t count, uint32_t max)
+{
+	semaphore->count = count;
+	semaphore->max = max;
+	semaphore->waiters = 0;
+}
+
+/**
+ * Takes a unit, waiting at most timeout ticks. Returns KERNEL_TIMEOUT when
+ * none came.
+ */
+char kernelSemTake(KernelSemaphore *semaphore, uint32_t timeout)
+{
+	uint32_t primask = criticalEnter();
+
+	if (semaphore->count > 0) {
+		semaphore->count--;
+		criticalExit(primask);
+		return KERNEL_OK;
+	}
+	if (timeout == 0 || __get_IPSR() != 0) {
+		criticalExit(primask);
+		return KERNEL_TIMEOUT;
+	}
+
+	block(&semaphore->waiters, timeout);
+	criticalExit(primask);
+
+	return kernelCurrent->waitResult;
+}
+
+/**
+ * Gives a unit to the highest priority waiter, or adds it to the count.
+ * Returns 1 when the count is already at its maximum. Interrupt safe.
+ */
+char kernelSemGive(KernelSemaphore *semaphore)
+{
+	uint32_t primask = criticalEnter();
+
+	if (semaphore->waiters) {
+		wake(semaphore->waiters, KERNEL_OK);
+		reschedule();
+	} else if (semaphore->count < semaphore->max) {
+		semaphore->count++;
+	} else {
+		criticalExit(primask);
+		return 1;
+	}
+
+	criticalExit(primask);
+	return 0;
+}
+
+/*
+ * Queues, items are copied with interrupts masked: keep them small.
+ */
+
+/**
+ * Copies an item at the back of the queue, waiting at most timeout ticks
+ * for room (none from an interrupt handler). Returns KERNEL_TIMEOUT when
+ * the queue stayed full.
+ */
+char kernelQueueSend(KernelQueue *queue, const void *item, uint32_t timeout)
+{
+	uint32_t primask = criticalEnter();
+
+	while (queue->count == queue->capacity) {
+		if (timeout == 0 || __get_IPSR() != 0) {
+			criticalExit(primask);
+			return KERNEL_TIMEOUT;
+		}
+
+		// woken by a receive, another sender may still take the room
+		block(&queue->senders, timeout);
+		criticalExit(primask);
+		if (kernelCurrent->waitResult != KERNEL_OK) {
+			return KERNEL_TIMEOUT;
+		}
+		primask = criticalEnter();
+	}
+
+	uint32_t tail = queue->head + queue->count;
+	if (tail >= queue->capacity) {
+		tail -= queue->capacity;
+	}
+	memcpy(queue->storage + tail * queue->itemSize, item, queue->itemSize);
+	queue->count++;
+
+	if (queue->receivers) {
+		wake(queue->receivers, KERNEL_OK);
+		reschedule();
+	}
+
+	criticalExit(primask);
+	return KERNEL_OK;
+}
+
+/**
+ * Copies the item at the front of the queue, waiting at most timeout ticks
+ * for one (none from an interrupt handler). Returns KERNEL_TIMEOUT when
+ * the queue stayed empty.
+ */
+char kernelQueueReceive(KernelQueue *queue, void *item, uint32_t timeout)
+{
+	uint32_t primask = criticalEnter();
+
+	while (queue->count == 0) {
+		if (timeout == 0 || __get_IPSR() != 0) {
+			criticalExit(primask);
+			return KERNEL_TIMEOUT;
+		}
+
+		block(&queue->receivers, timeout);
+		criticalExit(primask);
+		if (kernelCurrent->waitResult != KERNEL_OK) {
+			return KERNEL_TIMEOUT;
+		}
+		primask = criticalEnter();
+	}
+
+	memcpy(item, queue->storage + queue->head * queue->itemSize, queue->itemSize);
+	if (++queue->head == queue->capacity) {
+		queue->head = 0;
+	}
+	queue->count--;
+
+	if (queue->senders) {
+		wake(queue->senders, KERNEL_OK);
+		reschedule();
+	}
+
+	criticalExit(primask);
+	return KERNEL_OK;
+}
+
+/*
+ * Context switch
+ */
+
+/**
+ * Saves the context of the running task on its stack, selects the next one
+ * and restores its context. s16-s31 only move for tasks with an FPU frame
+ * (bit 4 of EXC_RETURN clear).
+ */
+__attribute__((naked)) void PendSV_Handler(void)
+{
+	__asm volatile (
+		"movw r3, #:lower16:kernelCurrent\n"
+		"movt r3, #:upper16:kernelCurrent\n"
+		"ldr r2, [r3]\n"
+		"cbz r2, 1f\n" // not started yet
+		"mrs r0, psp\n"
+		"isb\n"
+#if (__FPU_USED == 1)
+		"tst lr, #0x10\n"
+		"it eq\n"
+		"vstmdbeq r0!, {s16-s31}\n"
+#endif
+		"stmdb r0!, {r4-r11, lr}\n"
+		"str r0, [r2]\n"
+
+		"cpsid i\n"
+		"bl kernelSelect\n"
+		"cpsie i\n"
+
+		"movw r3, #:lower16:kernelCurrent\n"
+		"movt r3, #:upper16:kernelCurrent\n"
+		"ldr r2, [r3]\n"
+		"ldr r0, [r2]\n"
+		"ldmia r0!, {r4-r11, lr}\n"
+#if (__FPU_USED == 1)
+		"tst lr, #0x10\n"
+		"it eq\n"
+		"vldmiaeq r0!, {s16-s31}\n"
+#endif
+		"msr psp, r0\n"
+		"isb\n"
+		"1:\n"
+		"bx lr\n"
+	);
+}
+
+/**
+ * Starts the first task, from kernelStart(). The main stack restarts from
+ * its top, the initial value in the vector table.
+ */
+__attribute__((naked)) void SVC_Handler(void)
+{
+	__asm volatile (
+		"movw r3, #:lower16:kernelCurrent\n"
+		"movt r3, #:upper16:kernelCurrent\n"
+		"ldr r2, [r3]\n"
+		"ldr r0, [r2]\n"
+		"ldmia r0!, {r4-r11, lr}\n"
+		"msr psp, r0\n"
+
+		"movw r0, #:lower16:0xE000ED08\n" // SCB->VTOR
+		"movt r0, #:upper16:0xE000ED08\n"
+		"ldr r0, [r0]\n"
+		"ldr r0, [r0]\n"
+		"msr msp, r0\n"
+		"isb\n"
+		"bx lr\n"
+	);
+}
+
+/**
+ * Makes the first task of the highest ready priority current. Interrupts
+ * are disabled.
+ */
+void kernelSelect(void)
+{
+	uint32_t start = DWT->CYCCNT;
+
+	kernelCurrent = readyHead[31 - __CLZ(readyMask)];
+	kernelCurrent->switches++;
+	stats.switches++;
+
+	// masked by PendSV_Handler around the call, give or take the call itself
+	criticalRecord(DWT->CYCCNT - start);
+}
+
+/**
+ * Where the entry point of a task returns to.
+ */
+static void taskExit(void)
+{
+	uint32_t primask = criticalEnter();
+
+	readyRemove(kernelCurrent);
+	kernelCurrent->state = KERNEL_TASK_ENDED;
+	reschedule();
+
+	criticalExit(primask);
+	while (1);
+}
+
+/**
+ * Lowest priority task, runs the deferred timer callbacks (which must not
+ * block) and sleeps.
+ */
+static void idleEntry(void *arg)
+{
+	(void) arg;
+
+	while (1) {
+		timerIdle();
+	}
+}
+
+/**
+ * A wait timed out, from the SysTick handler.
+ */
+static void timeoutCallback(void *arg)
+{
+	KernelTask *task = arg;
+	uint32_t primask = criticalEnter();
+
+	if (task->state == KERNEL_TASK_BLOCKED) {
+		KernelMutex *mutex = task->waitMutex;
+
+		task->waitMutex = 0;
+		wake(task, KERNEL_TIMEOUT);
+
+		// the owner no longer inherits from this task
+		if (mutex) {
+			updateInheritance(mutex->owner);
+		}
+		reschedule();
+	}
+
+	criticalExit(primask);
+}
+
+static void readyAppend(KernelTask *task)
+{
+	uint8_t priority = task->priority;
+
+	task->next = 0;
+	if (readyTail[priority]) {
+		readyTail[priority]->next = task;
+	} else {
+		readyHead[priority] = task;
+	}
+	readyTail[priority] = task;
+	readyMask |= 1UL << priority;
+}
+
+static void readyRemove(KernelTask *task)
+{
+	uint8_t priority = task->priority;
+	KernelTask **link = &readyHead[priority];
+	KernelTask *previous = 0;
+
+	while (*link != task) {
+		previous = *link;
+		link = &(*link)->next;
+	}
+	*link = task->next;
+
+	if (readyTail[priority] == task) {
+		readyTail[priority] = previous;
+	}
+	if (readyHead[priority] == 0) {
+		readyMask &= ~(1UL << priority);
+	}
+}
+
+/**
+ * Pends a switch when the running task is no longer the one to run.
+ */
+static void reschedule(void)
+{
+	if (kernelCurrent && readyHead[31 - __CLZ(readyMask)] != kernelCurrent) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
+
+/**
+ * Inserts after the waiters of higher or equal priority.
+ */
+static void waitInsert(KernelTask **list, KernelTask *task)
+{
+	KernelTask **link = list;
+
+	while (*link && (*link)->priority >= task->priority) {
+		link = &(*link)->next;
+	}
+	task->next = *link;
+	*link = task;
+	task->waitList = list;
+}
+
+static void waitRemove(KernelTask *task)
+{
+	KernelTask **link = task->waitList;
+
+	while (*link != task) {
+		link = &(*link)->next;
+	}
+	*link = task->next;
+	task->waitList = 0;
+}
+
+/**
+ * Blocks the running task on a wait list (none for a sleep). The switch
+ * happens when the caller leaves its critical section.
+ */
+static void block(KernelTask **list, uint32_t timeout)
+{
+	KernelTask *task = kernelCurrent;
+
+	readyRemove(task);
+	task->state = KERNEL_TASK_BLOCKED;
+	task->waitResult = KERNEL_TIMEOUT;
+	if (list) {
+		waitInsert(list, task);
+	}
+	if (timeout != KERNEL_FOREVER) {
+		timerStart(&task->timer, timeout, 0);
+	}
+
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+static void wake(KernelTask *task, uint8_t result)
+{
+	if (task->waitList) {
+		waitRemove(task);
+	}
+	timerStop(&task->timer);
+
+	task->waitResult = result;
+	task->state = KERNEL_TASK_READY;
+	readyAppend(task);
+}
+
+/**
+ * Moves the task to the list of its new priority, ready or waiting.
+ */
+static void setPriority(KernelTask *task, uint8_t priority)
+{
+	if (task->state == KERNEL_TASK_READY) {
+		readyRemove(task);
+		task->priority = priority;
+		readyAppend(task);
+	} else {
+		task->priority = priority;
+		if (task->waitList) {
+			KernelTask **list = task->waitList;
+			waitRemove(task);
+			waitInsert(list, task);
+		}
+	}
+}
+
+/**
+ * Recomputes the priority of a mutex owner from its waiters, then of the
+ * owner of the mutex it waits for, along the chain.
+ */
+static void updateInheritance(KernelTask *owner)
+{
+	while (owner) {
+		uint8_t priority = owner->basePriority;
+
+		for (KernelMutex *mutex = owner->heldMutexes; mutex; mutex = mutex->nextHeld) {
+			if (mutex->waiters && mutex->waiters->priority > priority) {
+				priority = mutex->waiters->priority;
+			}
+		}
+		if (priority == owner->priority) {
+			return;
+		}
+
+		setPriority(owner, priority);
+		owner = owner->waitMutex ? owner->waitMutex->owner : 0;
+	}
+}
+
+#endif /* USE_KERNEL */
@@ -0,0 +1,150 @@
+/*
+ * kernel.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Preemptive priority kernel, built with USE_KERNEL.
+ *
+ * Tasks have static control blocks and stacks (KERNEL_TASK_DEFINE) and run
+ * in thread mode on the process stack; interrupt handlers keep the main
+ * stack. The highest priority ready task runs; tasks of equal priority run
+ * in turn when one blocks or yields, there is no time slicing.
+ *
+ * PendSV (lowest priority) switches context: r4-r11 are saved by hand, the
+ * FPU registers s16-s31 only for tasks that used the FPU (lazy stacking,
+ * the core saves s0-s15 on first use in the handler). A switch requested
+ * by an interrupt handler happens when the last handler returns.
+ *
+ * Mutexes inherit priority: the owner runs at the priority of its highest
+ * waiter, through chains of mutexes, until it unlocks. Semaphores and
+ * queues may be given or sent from interrupt handlers with no timeout;
+ * nothing else may be called from a handler.
+ *
+ * Timeouts and sleeps are in ticks (ms) and use the timer wheel of timer.h,
+ * so the kernel stays tickless. The run-to-completion scheduler of sched.h
+ * needs PendSV too and is not dispatched under USE_KERNEL.
+ *
+ * Interrupt latency: the kernel, like the rest of the firmware, masks
+ * interrupts (PRIMASK) only through critical.h, which times every section
+ * including the task selection of PendSV. The longest one, wherever it
+ * ran, is reported in KernelStats and must stay below
+ * KERNEL_MAX_MASKED_CYCLES. runKernelBenchmarks() checks it, and the
+ * switch cost against KERNEL_MAX_SWITCH_CYCLES.
+ *
+ * Usage:
+ *
+ *   static void sensorTask(void *arg);
+ *   KERNEL_TASK_DEFINE(sensor, sensorTask, 0, 3, 512); // priority 3, 512 bytes
+ *
+ *   kernelAddTask(&sensor);
+ *   kernelStart(); // does not return
+ */
+
+#ifndef KERNEL_H_
+#define KERNEL_H_
+
+#include <stdint.h>
+#include "timer.h"
+
+#define KERNEL_MAX_PRIORITY 31      // priorities 0 (idle) to 31, higher runs first
+#define KERNEL_FOREVER UINT32_MAX   // timeout of a wait that never gives up
+#define KERNEL_MAX_MASKED_CYCLES 1000 // 6 us at 168 MHz, 19 us at 53.76 MHz
+#define KERNEL_MAX_SWITCH_CYCLES 500  // from a give or yield to the task running, FPU frame included
+// The idle task runs every TIMER_DEFERRED callback on its stack, which
+// also holds an exception frame with the FPU registers (26 words) and the
+// registers PendSV saves (25 words). Overflows are not detected: check
+// kernelGetStackFree(&kernelIdleTask) after adding deferred callbacks.
+#define KERNEL_IDLE_STACK_SIZE 1024 // bytes
+
+// Results of waits
+#define KERNEL_OK 0
+#define KERNEL_TIMEOUT 1
+
+typedef enum {
+	KERNEL_TASK_READY,
+	KERNEL_TASK_BLOCKED,
+	KERNEL_TASK_ENDED
+} KernelTaskState;
+
+struct KernelMutex;
+
+typedef struct KernelTask {
+	uint32_t *sp;                       // saved stack pointer, first for PendSV
+	struct KernelTask *next;            // ready list or wait list
+	struct KernelTask **waitList;       // list head while blocked on an object
+	struct KernelMutex *waitMutex;      // mutex blocked on, for inheritance
+	struct KernelMutex *heldMutexes;
+	void (*entry)(void *arg);
+	void *arg;
+	uint32_t *stack;
+	uint32_t stackSize;                 // bytes
+	Timer timer;                        // timeouts and sleeps
+	uint8_t basePriority;
+	uint8_t priority;                   // effective, raised by inheritance
+	uint8_t state;
+	uint8_t waitResult;
+	uint32_t switches;                  // times switched in
+} KernelTask;
+
+typedef struct KernelMutex {
+	KernelTask *owner;
+	KernelTask *waiters;                // highest priority first
+	struct KernelMutex *nextHeld;       // other mutexes of the owner
+} KernelMutex;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max;
+	KernelTask *waiters;
+} KernelSemaphore;
+
+typedef struct {
+	uint8_t *storage;
+	uint16_t itemSize;
+	uint16_t capacity;
+	uint16_t head;
+	uint16_t count;
+	KernelTask *receivers;              // waiting for an item
+	KernelTask *senders;                // waiting for room
+} KernelQueue;
+
+typedef struct {
+	uint32_t switches;
+	uint32_t maxMaskedCycles;           // longest section with interrupts masked, see critical.h
+} KernelStats;
+
+// Defines a task with a stack of stackSize bytes (multiple of 8)
+#define KERNEL_TASK_DEFINE(name, taskEntry, taskArg, taskPriority, taskStackSize) \
+	static uint64_t name##_stack[(taskStackSize) / 8]; \
+	KernelTask name = { .entry = (taskEntry), .arg = (taskArg), \
+		.stack = (uint32_t *) name##_stack, .stackSize = (taskStackSize), \
+		.basePriority = (taskPriority), .priority = (taskPriority) }
+
+// Defines a queue of capacity items of type
+#define KERNEL_QUEUE_DEFINE(name, type, capacity) \
+	static type name##_storage[capacity]; \
+	KernelQueue name = { (uint8_t *) name##_storage, sizeof(type), (capacity), 0, 0, 0, 0 }
+
+extern KernelTask kernelIdleTask;
+
+char kernelAddTask(KernelTask *task);
+void kernelStart(void);
+KernelTask *kernelCurrentTask(void);
+void kernelYield(void);
+void kernelSleep(uint32_t ticks);
+uint32_t kernelGetStackFree(const KernelTask *task);
+void kernelGetStats(KernelStats *statistics);
+
+void kernelMutexInit(KernelMutex *mutex);
+char kernelMutexLock(KernelMutex *mutex, uint32_t timeout);
+char kernelMutexUnlock(KernelMutex *mutex);
+
+void kernelSemInit(KernelSemaphore *semaphore, uint32_t count, uint32_t max);
+char kernelSemTake(KernelSemaphore *semaphore, uint32_t timeout);
+char kernelSemGive(KernelSemaphore *semaphore);
+
+char kernelQueueSend(KernelQueue *queue, const void *item, uint32_t timeout);
+char kernelQueueReceive(KernelQueue *queue, void *item, uint32_t timeout);
+
+#endif /* KERNEL_H_ */
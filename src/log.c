@@ -0,0 +1,137 @@
+/*
+ * log.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * The ring buffer has any number of producers (thread and handlers) and
+ * one consumer (logDrain). A producer reserves its words and its sequence
+ * number together by moving the head with LDREX/STREX (a dropped record
+ * still takes a number, so the decoder sees the gap), fills them, then writes the header last; the
+ * consumer stops at the first header not written yet and clears each
+ * word it has consumed. No interrupt is ever masked.
+ */
+#include <stdarg.h>
+#include "stm32f4xx.h"
+#include "log.h"
+
+#define LOG_MASK (LOG_BUFFER_WORDS - 1)
+#define RECORD_WORDS(count) ((count) + 2)
+
+// reservation word: next word reserved in bits 0-23, sequence in 24-31
+#define POSITION_MASK 0x00FFFFFF
+#define SEQUENCE_SHIFT 24
+
+// Private static variable definitions
+
+static volatile uint32_t buffer[LOG_BUFFER_WORDS];
+static volatile uint32_t head = 0;  // reservation word, position free-running modulo 2^24
+static volatile uint32_t tail = 0;  // next word consumed, modulo 2^24
+
+static LogSink logSink = 0;
+static LogStats stats;
+
+// Function definitions
+
+/**
+ * Sets where logDrain() sends records (consoleWrite, itmWrite...) and
+ * starts the cycle counter used for timestamps.
+ */
+void logInit(LogSink sink)
+{
+	logSink = sink;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * Appends a record, called by LOG(). The record is dropped when the
+ * buffer is full.
+ */
+void logWrite(uint32_t id, unsigned int count, ...)
+{
+	uint32_t reservation;
+	uint32_t start;
+	uint32_t next;
+	uint32_t words = RECORD_WORDS(count);
+	va_list va;
+
+	// reserve the words and the sequence number of the record
+	do {
+		reservation = __LDREXW((uint32_t *) &head);
+		start = reservation & POSITION_MASK;
+		next = (reservation & ~POSITION_MASK) + (1UL << SEQUENCE_SHIFT);
+		if (((start + words - tail) & POSITION_MASK) <= LOG_BUFFER_WORDS) {
+			next |= (start + words) & POSITION_MASK;
+		} else {
+			next |= start; // full, only the number is used
+		}
+	} while (__STREXW(next, (uint32_t *) &head));
+
+	if ((next & POSITION_MASK) == start) {
+		stats.dropped++;
+		return;
+	}
+
+	buffer[(start + 1) & LOG_MASK] = DWT->CYCCNT;
+
+	va_start(va, count);
+	for (unsigned int i = 0; i < count; i++) {
+		buffer[(start + 2 + i) & LOG_MASK] = va_arg(va, uint32_t);
+	}
+	va_end(va);
+
+	// the header commits the record
+	__DMB();
+	buffer[start & LOG_MASK] = LOG_MAGIC
+			| (reservation >> SEQUENCE_SHIFT) << 20
+			| count << 16
+			| (id & 0xFFFF);
+}
+
+/**
+ * Sends the committed records to the sink. Returns the number of records
+ * sent. Call from a single context, typically the idle loop.
+ */
+unsigned int logDrain(void)
+{
+	uint32_t record[RECORD_WORDS(LOG_MAX_ARGS)];
+	unsigned int drained = 0;
+
+	while (tail != (head & POSITION_MASK)) {
+		uint32_t header = buffer[tail & LOG_MASK];
+		if ((header & 0xF0000000) != LOG_MAGIC) {
+			break; // reserved, not written yet
+		}
+
+		uint32_t words = RECORD_WORDS((header >> 16) & 0x0F);
+		uint32_t used = ((head & POSITION_MASK) - tail) & POSITION_MASK;
+		if (used > stats.peak) {
+			stats.peak = used;
+		}
+
+		for (uint32_t i = 0; i < words; i++) {
+			record[i] = buffer[(tail + i) & LOG_MASK];
+		}
+		// a payload word left behind could later look like a header
+		for (uint32_t i = 0; i < words; i++) {
+			buffer[(tail + i) & LOG_MASK] = 0;
+		}
+		__DMB();
+		tail = (tail + words) & POSITION_MASK;
+
+		if (logSink) {
+			logSink((const char *) record, words * sizeof(uint32_t));
+		}
+		stats.records++;
+		drained++;
+	}
+
+	return drained;
+}
+
+void logGetStats(LogStats *statistics)
+{
+	*statistics = stats;
+}
@@ -0,0 +1,67 @@
+/*
+ * log.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Deferred binary logging.
+ *
+ * LOG() stores the ID of its format string, a cycle counter timestamp and
+ * the raw arguments in a ring buffer; nothing is formatted on the target.
+ * The format strings are kept in the non-loaded .logstr section of the ELF
+ * and the ID is the offset of the string there, so they cost no flash.
+ * logDrain() sends the records to a sink from the idle loop and
+ * tools/log_decode.py turns them back into text with the ELF.
+ *
+ *   LOG("page %u remapped to spare %u", page, spare);
+ *
+ * Arguments are 32-bit words: integers, characters and pointers (%d %i %u
+ * %x %X %c %p). %s only works for strings in flash, which the decoder
+ * reads from the ELF. At most LOG_MAX_ARGS arguments. LOG() may be used
+ * from interrupt handlers.
+ *
+ * Record on the wire, little-endian words:
+ *   header     bits 0-15 ID, 16-19 argument count, 20-27 sequence, 28-31 0xA
+ *   timestamp  DWT cycle counter
+ *   arguments
+ *
+ * The sequence counts every LOG() call, dropped records included, in
+ * buffer order: a gap means records were lost.
+ */
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+
+#define LOG_BUFFER_WORDS 512 // power of two
+#define LOG_MAX_ARGS 8
+
+#define LOG_MAGIC 0xA0000000
+
+// argument count of a variadic macro call, 0 to 8
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, count, ...) count
+
+#define LOG(format, ...) \
+	do { \
+		static const char logFormat[] __attribute__((section(".logstr"), used)) = format; \
+		_Static_assert(LOG_NARGS(__VA_ARGS__) <= LOG_MAX_ARGS, "too many log arguments"); \
+		logWrite((uint32_t) logFormat, LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+	} while (0)
+
+// Receives drained records, returns the number of bytes it accepted
+typedef int (*LogSink)(const char *data, int length);
+
+typedef struct {
+	unsigned int records;
+	unsigned int dropped; // records lost to a full buffer
+	unsigned int peak;    // highest buffer fill seen by logDrain, in words
+} LogStats;
+
+void logInit(LogSink sink);
+void logWrite(uint32_t id, unsigned int count, ...);
+unsigned int logDrain(void);
+void logGetStats(LogStats *statistics);
+
+#endif /* LOG_H_ */
@@ -28,11 +28,44 @@ SOFTWARE.
 */
 
 /* Includes */
+#include <stdio.h>
 #include "stm32f4xx.h"
 #include "macros_utiles.h"
 #include "eeprom.h"
+#include "benchmark.h"
+#include "stack.h"
+#include "console.h"
+#include "itm.h"
+#include "log.h"
+#include "timebase.h"
+#include "timer.h"
+#include "sched.h"
+#include "kernel.h"
+#include "fault.h"
+#include "watchdog.h"
 
+#ifndef USE_KERNEL
+#define SIGNAL_EEPROM_CHECKPOINT 1
 
+#define CHECKPOINT_PERIOD 60000 // ms between counter checkpoints
+
+// EEPROM work done in task context rather than in the timer interrupt
+static void eepromHandler(const SchedEvent *event)
+{
+	if (event->signal == SIGNAL_EEPROM_CHECKPOINT) {
+		eepromCheckpointCounters();
+	}
+}
+
+SCHED_TASK_DEFINE(eepromTask, eepromHandler, 1, 4);
+
+static Timer checkpointTimer;
+
+static void postCheckpoint(void *arg)
+{
+	schedPost(&eepromTask, SIGNAL_EEPROM_CHECKPOINT, 0, 0);
+}
+#endif
 
 /**
 **===========================================================================
@@ -63,9 +96,30 @@ int main(void)
 	  }
   }
 
+#ifdef RUN_BENCHMARKS
+  // results in benchmarkResults
+  runBenchmarks();
+#endif
+
+  // 1 ms tick, EEPROM write timeouts rely on it
+  timebaseInit();
+
+  // printf output on USART2 (PA2), 115200 baud, trace events on SWO
+  consoleInit(CONSOLE_USART2, 115200, CONSOLE_DROP);
+  itmInit(0);
+
+  // LOG() records go out on the console from the idle loop, mixed with the
+  // printf text; tools/log_decode.py skips what is not a record
+  logInit(consoleWrite);
+
   // init, write and read eeprom
   initEEPROM();
-  EcrireMemoireEEPROM(0x0000, EEPROM_MAX_ADDRESS, write_buffer);
+  // saves the record of a fault that caused the last reset
+  faultInit();
+  if (EcrireMemoireEEPROM(0x0000, EEPROM_MAX_ADDRESS, write_buffer)) {
+	  // a page failed verification and no spare page was left
+	  eeprom_validatation_result = -1;
+  }
   LireMemoireEEPROM(0x0000, EEPROM_MAX_ADDRESS, read_buffer);
 
   // validate data
@@ -80,14 +134,35 @@ int main(void)
 	  eeprom_validatation_result = 1;
   }
 
+  printf("EEPROM validation %s\n", eeprom_validatation_result == 1 ? "passed" : "failed");
+
+  // deepest main stack use so far, compare with tools/stack_report.py
+  volatile uint32_t stack_high_water = stackGetHighWater();
+  (void) stack_high_water;
+
   // NOTE:
   // ADD BREAKPOINT HERE IN DEBUG MODE TO CHECK THAT
   // eeprom_validatation_result IS EQUAL TO 1.
 
-  /* Infinite loop */
-  int i = 0;
-  while (1)
-  {
-	i++;
-  }
+  // supervised from here on: the blocking EEPROM test above takes over a
+  // second, writes at run time go through eepromWriteAsync()
+  watchdogInit(1000);
+
+#ifdef USE_KERNEL
+#ifdef RUN_BENCHMARKS
+  // switch cost and masked time, in benchmarkResults once the tasks end
+  runKernelBenchmarks();
+#endif
+  kernelStart();
+#else
+  // tasks run from PendSV, the thread idles
+  schedInit();
+  schedAddTask(&eepromTask);
+
+  // wear counters reach the EEPROM even if no write triggers a save
+  timerInit(&checkpointTimer, postCheckpoint, 0, TIMER_ISR);
+  timerStart(&checkpointTimer, CHECKPOINT_PERIOD, CHECKPOINT_PERIOD);
+
+  schedRun();
+#endif
 }
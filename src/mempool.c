@@ -0,0 +1,133 @@
+/*
+ * mempool.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stm32f4xx.h"
+#include "mempool.h"
+#include "critical.h"
+
+/*
+ * Size classes served by memAlloc(), smallest first. They live in SRAM so
+ * that blocks can be given to DMA; pools for core-only data can be defined
+ * in CCM-RAM with MEMPOOL_DEFINE_CCM.
+ */
+MEMPOOL_DEFINE(memPool32, 32, 16);
+MEMPOOL_DEFINE(memPool64, 64, 8);
+MEMPOOL_DEFINE(memPool256, 256, 4);
+
+static MemPool *const sizeClasses[] = { &memPool32, &memPool64, &memPool256 };
+
+#define SIZE_CLASS_COUNT (sizeof(sizeClasses) / sizeof(sizeClasses[0]))
+
+// Function definitions
+
+/**
+ * Takes a block from the pool, or returns 0 when all blocks are in use.
+ */
+void *mempoolAlloc(MemPool *pool)
+{
+	void *block = 0;
+	uint32_t primask = criticalEnter();
+
+	if (pool->freeList) {
+		block = pool->freeList;
+		pool->freeList = pool->freeList->next;
+	} else if (pool->watermark < pool->blockCount) {
+		block = pool->storage + (uint32_t) pool->watermark * pool->blockSize;
+		pool->watermark++;
+	}
+
+	if (block) {
+		pool->used++;
+		if (pool->used > pool->peak) {
+			pool->peak = pool->used;
+		}
+	} else {
+		pool->failures++;
+	}
+
+	criticalExit(primask);
+	return block;
+}
+
+/**
+ * Returns a block to the pool it was allocated from.
+ */
+void mempoolFree(MemPool *pool, void *block)
+{
+	if (block == 0) {
+		return;
+	}
+
+	uint32_t primask = criticalEnter();
+
+	((MemPoolBlock *) block)->next = pool->freeList;
+	pool->freeList = block;
+	pool->used--;
+
+	criticalExit(primask);
+}
+
+/**
+ * Returns 1 when the address is a block of the pool.
+ */
+int mempoolOwns(const MemPool *pool, const void *block)
+{
+	const uint8_t *address = block;
+	return address >= pool->storage
+		&& address < pool->storage + (uint32_t) pool->blockCount * pool->blockSize;
+}
+
+void mempoolGetStats(const MemPool *pool, MemPoolStats *statistics)
+{
+	statistics->blockSize = pool->blockSize;
+	statistics->blockCount = pool->blockCount;
+	statistics->used = pool->used;
+	statistics->peak = pool->peak;
+	statistics->failures = pool->failures;
+}
+
+/**
+ * Allocates a block of at least size bytes from the smallest size class
+ * with a free block. Returns 0 when none is left.
+ */
+void *memAlloc(unsigned int size)
+{
+	for (unsigned int i = 0; i < SIZE_CLASS_COUNT; i++) {
+		if (sizeClasses[i]->blockSize >= size) {
+			void *block = mempoolAlloc(sizeClasses[i]);
+			if (block) {
+				return block;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Releases a block from memAlloc().
+ */
+void memFree(void *block)
+{
+	for (unsigned int i = 0; i < SIZE_CLASS_COUNT; i++) {
+		if (mempoolOwns(sizeClasses[i], block)) {
+			mempoolFree(sizeClasses[i], block);
+			return;
+		}
+	}
+}
+
+unsigned int memGetPoolCount(void)
+{
+	return SIZE_CLASS_COUNT;
+}
+
+void memGetPoolStats(unsigned int index, MemPoolStats *statistics)
+{
+	if (index < SIZE_CLASS_COUNT) {
+		mempoolGetStats(sizeClasses[index], statistics);
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * mempool.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Fixed-block memory pools, there is no heap.
+ *
+ * A pool is a static array of equal blocks. Free blocks are chained
+ * through their first word; blocks never allocated yet are handed out from
+ * a watermark, so a pool needs no initialization and every operation is
+ * O(1). Allocation and release mask interrupts for a few instructions and
+ * may be called from interrupt handlers.
+ *
+ * Usage:
+ *
+ *   MEMPOOL_DEFINE(messagePool, 32, 8)        // SRAM, reachable by DMA
+ *   MEMPOOL_DEFINE_CCM(scratchPool, 128, 4)   // CCM-RAM, core only
+ *
+ *   void *block = mempoolAlloc(&messagePool);
+ *   ...
+ *   mempoolFree(&messagePool, block);
+ *
+ * memAlloc()/memFree() pick from the size classes of mempool.c, the
+ * smallest class that fits and has a free block.
+ */
+
+#ifndef MEMPOOL_H_
+#define MEMPOOL_H_
+
+#include <stdint.h>
+#include "sections.h"
+
+#define MEMPOOL_ALIGNMENT 8 // doubles and LDRD/STRD
+
+// block size rounded up to the alignment, and large enough for the link
+#define MEMPOOL_BLOCK_SIZE(size) \
+	((((size) > sizeof(MemPoolBlock) ? (size) : sizeof(MemPoolBlock)) \
+		+ MEMPOOL_ALIGNMENT - 1) / MEMPOOL_ALIGNMENT * MEMPOOL_ALIGNMENT)
+
+typedef struct MemPoolBlock {
+	struct MemPoolBlock *next;
+} MemPoolBlock;
+
+typedef struct {
+	uint8_t *storage;
+	uint16_t blockSize;
+	uint16_t blockCount;
+	uint16_t watermark;      // blocks never allocated start here
+	uint16_t used;
+	uint16_t peak;           // most blocks in use at once
+	uint16_t failures;       // allocations refused, pool empty
+	MemPoolBlock *freeList;
+} MemPool;
+
+typedef struct {
+	unsigned int blockSize;
+	unsigned int blockCount;
+	unsigned int used;
+	unsigned int peak;
+	unsigned int failures;
+} MemPoolStats;
+
+#define MEMPOOL_INITIALIZER(storage, size, count) \
+	{ (storage), MEMPOOL_BLOCK_SIZE(size), (count), 0, 0, 0, 0, 0 }
+
+#define MEMPOOL_DEFINE_IN(name, size, count, placement) \
+	placement static uint8_t name##_storage[(count) * MEMPOOL_BLOCK_SIZE(size)] \
+		__attribute__((aligned(MEMPOOL_ALIGNMENT))); \
+	MemPool name = MEMPOOL_INITIALIZER(name##_storage, size, count)
+
+#define MEMPOOL_DEFINE(name, size, count) MEMPOOL_DEFINE_IN(name, size, count, )
+#define MEMPOOL_DEFINE_CCM(name, size, count) MEMPOOL_DEFINE_IN(name, size, count, CCMRAM_BSS)
+
+void *mempoolAlloc(MemPool *pool);
+void mempoolFree(MemPool *pool, void *block);
+int mempoolOwns(const MemPool *pool, const void *block);
+void mempoolGetStats(const MemPool *pool, MemPoolStats *statistics);
+
+void *memAlloc(unsigned int size);
+void memFree(void *block);
+unsigned int memGetPoolCount(void);
+void memGetPoolStats(unsigned int index, MemPoolStats *statistics);
+
+#endif /* MEMPOOL_H_ */
@@ -0,0 +1,109 @@
+/*
+ * pt.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Protothreads, stackless coroutines for driver sequences.
+ *
+ * A protothread is a function that returns at each wait and resumes after
+ * it on the next call. The resume point is a line number kept in a Pt, the
+ * body being one switch statement (a case label at every wait), so a
+ * protothread costs two bytes and needs no stack of its own.
+ *
+ *   static PtStatus blink(Blink *b)
+ *   {
+ *       PT_BEGIN(&b->pt);
+ *       while (1) {
+ *           ledToggle();
+ *           timeoutStart(&b->timeout, 500000);
+ *           PT_WAIT_UNTIL(&b->pt, timeoutExpired(&b->timeout));
+ *       }
+ *       PT_END(&b->pt);
+ *   }
+ *
+ *   PT_INIT(&b.pt);
+ *   while (PT_SCHEDULE(blink(&b))) { ... }
+ *
+ * Local variables do not survive a wait: keep the state of the sequence in
+ * the structure next to its Pt. A protothread cannot contain switch
+ * statements of its own, and only one wait per line.
+ */
+
+#ifndef PT_H_
+#define PT_H_
+
+#include <stdint.h>
+
+typedef struct {
+	uint16_t lc; // line to resume at, 0 at the start
+} Pt;
+
+typedef enum {
+	PT_WAITING = 0,
+	PT_YIELDED = 1,
+	PT_EXITED = 2,
+	PT_ENDED = 3
+} PtStatus;
+
+#define PT_INIT(pt) ((pt)->lc = 0)
+
+#define PT_BEGIN(pt) \
+	{ \
+		char ptYielded = 1; \
+		(void) ptYielded; \
+		switch ((pt)->lc) { \
+		case 0:
+
+#define PT_END(pt) \
+		} \
+		PT_INIT(pt); \
+		return PT_ENDED; \
+	}
+
+// Returns until cond holds, cond is evaluated again at each call
+#define PT_WAIT_UNTIL(pt, cond) \
+	do { \
+		(pt)->lc = __LINE__; \
+	case __LINE__: \
+		if (!(cond)) { \
+			return PT_WAITING; \
+		} \
+	} while (0)
+
+#define PT_WAIT_WHILE(pt, cond) PT_WAIT_UNTIL(pt, !(cond))
+
+// Returns once, to let other work run
+#define PT_YIELD(pt) \
+	do { \
+		ptYielded = 0; \
+		(pt)->lc = __LINE__; \
+	case __LINE__: \
+		if (!ptYielded) { \
+			return PT_YIELDED; \
+		} \
+	} while (0)
+
+// Runs a child protothread until it ends or exits
+#define PT_SPAWN(pt, child, call) \
+	do { \
+		PT_INIT(child); \
+		PT_WAIT_WHILE(pt, (call) < PT_EXITED); \
+	} while (0)
+
+#define PT_EXIT(pt) \
+	do { \
+		PT_INIT(pt); \
+		return PT_EXITED; \
+	} while (0)
+
+#define PT_RESTART(pt) \
+	do { \
+		PT_INIT(pt); \
+		return PT_WAITING; \
+	} while (0)
+
+// Nonzero while the protothread has not ended or exited
+#define PT_SCHEDULE(call) ((call) < PT_EXITED)
+
+#endif /* PT_H_ */
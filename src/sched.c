@@ -0,0 +1,124 @@
+/*
+ * sched.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stm32f4xx.h"
+#include "sched.h"
+#include "timer.h"
+#include "critical.h"
+
+// Private static variable definitions
+
+static SchedTask *tasks[SCHED_MAX_PRIORITY + 1];
+
+// a bit per priority with queued events
+static volatile uint32_t ready = 0;
+
+// Function definitions
+
+/**
+ * Gives PendSV the lowest priority, below SysTick and every interrupt.
+ */
+void schedInit(void)
+{
+	NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+}
+
+/**
+ * Registers a task at its priority. Returns 1 when the priority is out of
+ * range or already taken.
+ */
+char schedAddTask(SchedTask *task)
+{
+	if (task->priority > SCHED_MAX_PRIORITY || tasks[task->priority]) {
+		return 1;
+	}
+
+	tasks[task->priority] = task;
+	return 0;
+}
+
+/**
+ * Queues an event for the task and pends the dispatch. Returns 1 when the
+ * queue is full (the event is dropped and counted) or the task was not
+ * added.
+ */
+char schedPost(SchedTask *task, uint16_t signal, uint16_t param, void *data)
+{
+	// checked before indexing tasks, a task that was never added may have any priority
+	if (task->priority > SCHED_MAX_PRIORITY) {
+		task->overflows++;
+		return 1;
+	}
+
+	uint32_t primask = criticalEnter();
+
+	if (tasks[task->priority] != task || task->count == task->queueSize) {
+		task->overflows++;
+		criticalExit(primask);
+		return 1;
+	}
+
+	unsigned int tail = task->head + task->count;
+	if (tail >= task->queueSize) {
+		tail -= task->queueSize;
+	}
+	task->queue[tail].signal = signal;
+	task->queue[tail].param = param;
+	task->queue[tail].data = data;
+
+	task->count++;
+	if (task->count > task->peak) {
+		task->peak = task->count;
+	}
+	ready |= 1UL << task->priority;
+
+	criticalExit(primask);
+
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	return 0;
+}
+
+/**
+ * Dispatches queued events until none is left, highest priority first.
+ * Called from PendSV_Handler.
+ */
+void schedDispatch(void)
+{
+	while (1) {
+		uint32_t primask = criticalEnter();
+
+		if (ready == 0) {
+			criticalExit(primask);
+			return;
+		}
+
+		SchedTask *task = tasks[31 - __CLZ(ready)];
+		SchedEvent event = task->queue[task->head];
+
+		if (++task->head == task->queueSize) {
+			task->head = 0;
+		}
+		if (--task->count == 0) {
+			ready &= ~(1UL << task->priority);
+		}
+		task->dispatched++;
+
+		criticalExit(primask);
+
+		task->handler(&event);
+	}
+}
+
+/**
+ * Idle loop of the thread, runs the deferred timer callbacks and sleeps
+ * until the next interrupt. Does not return.
+ */
+void schedRun(void)
+{
+	while (1) {
+		timerIdle();
+	}
+}
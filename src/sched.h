@@ -0,0 +1,72 @@
+/*
+ * sched.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Run-to-completion task scheduler.
+ *
+ * A task is an event handler with a queue of events. Posting an event,
+ * from an interrupt handler or from another task, queues it and pends
+ * PendSV; PendSV_Handler then dispatches the queued events, always from
+ * the highest priority task that has one, each handler running to
+ * completion before the next. Tasks share the main stack and never preempt
+ * each other, interrupts preempt them all. The worst dispatch latency of a
+ * task is the longest handler of the tasks, plus the interrupt load.
+ *
+ * PendSV has the lowest priority, so tasks only run when no interrupt
+ * handler is active. The thread itself becomes the idle loop: it runs the
+ * deferred timer callbacks (timer.h) and sleeps.
+ *
+ * Usage:
+ *
+ *   static void eepromHandler(const SchedEvent *event);
+ *   SCHED_TASK_DEFINE(eepromTask, eepromHandler, 3, 8) // priority 3, 8 events
+ *
+ *   schedInit();
+ *   schedAddTask(&eepromTask);
+ *   schedRun(); // does not return
+ *
+ *   // anywhere, interrupt handlers included
+ *   schedPost(&eepromTask, EEPROM_WRITE_DONE, page, 0);
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+#define SCHED_MAX_PRIORITY 31 // priorities 0 to 31, higher runs first
+
+typedef struct {
+	uint16_t signal;
+	uint16_t param;
+	void *data;
+} SchedEvent;
+
+typedef void (*SchedHandler)(const SchedEvent *event);
+
+typedef struct {
+	SchedHandler handler;
+	SchedEvent *queue;
+	uint8_t queueSize;
+	uint8_t priority;
+	uint8_t head;            // next event to dispatch
+	uint8_t count;
+	uint8_t peak;            // most events queued at once
+	uint16_t overflows;      // events refused, queue full
+	uint32_t dispatched;
+} SchedTask;
+
+// Defines a task and its queue of depth events (at most 255)
+#define SCHED_TASK_DEFINE(name, handler, priority, depth) \
+	static SchedEvent name##_queue[depth]; \
+	SchedTask name = { (handler), name##_queue, (depth), (priority), 0, 0, 0, 0, 0 }
+
+void schedInit(void);
+char schedAddTask(SchedTask *task);
+char schedPost(SchedTask *task, uint16_t signal, uint16_t param, void *data);
+void schedDispatch(void);
+void schedRun(void);
+
+#endif /* SCHED_H_ */
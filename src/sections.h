@@ -0,0 +1,29 @@
+/*
+ * sections.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Placement of code and data outside the default flash/SRAM sections.
+ *
+ * RAMFUNC     code copied to SRAM with .data at reset. It runs without
+ *             flash wait states or ART cache misses. Calls between flash
+ *             and SRAM are out of BL range, hence long_call.
+ * CCMRAM      initialized data in CCM-RAM, copied from flash at reset.
+ * CCMRAM_BSS  zero initialized data in CCM-RAM, cleared at reset.
+ * NOINIT      CCM-RAM left untouched by the startup code, it keeps its
+ *             content across a reset (not a power cycle).
+ *
+ * CCM-RAM is only reachable by the core (no DMA) and cannot hold code.
+ * It suits state touched by interrupt handlers and hot lookup tables.
+ */
+
+#ifndef SECTIONS_H_
+#define SECTIONS_H_
+
+#define RAMFUNC __attribute__((section(".ramfunc"), long_call, noinline))
+#define CCMRAM __attribute__((section(".ccmram")))
+#define CCMRAM_BSS __attribute__((section(".ccmbss")))
+#define NOINIT __attribute__((section(".noinit")))
+
+#endif /* SECTIONS_H_ */
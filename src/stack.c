@@ -0,0 +1,58 @@
+/*
+ * stack.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stack.h"
+
+// Linker script symbols, bounds of the main stack area
+extern uint32_t _sstack;
+extern uint32_t _estack;
+
+// deepest word found overwritten so far, the scan resumes from there
+static uint32_t *deepest = 0;
+
+/**
+ * Size of the main stack area in bytes.
+ */
+uint32_t stackGetSize(void)
+{
+	return (uint32_t) ((char *) &_estack - (char *) &_sstack);
+}
+
+/**
+ * Largest number of bytes the main stack has used since reset.
+ *
+ * Painted words are only ever overwritten, so each call scans the range
+ * between the bottom of the stack and the previous high-water mark.
+ */
+uint32_t stackGetHighWater(void)
+{
+	uint32_t *word = &_sstack;
+	uint32_t *limit = deepest ? deepest : &_estack;
+
+	while (word < limit && *word == STACK_PAINT_PATTERN) {
+		word++;
+	}
+	deepest = word;
+
+	return (uint32_t) ((char *) &_estack - (char *) word);
+}
+
+/**
+ * Bytes of the main stack never used since reset.
+ */
+uint32_t stackGetFree(void)
+{
+	return stackGetSize() - stackGetHighWater();
+}
+
+/**
+ * Returns 1 when the bottom word of the stack area has been overwritten,
+ * the stack then reached the CCM-RAM data below it and may have corrupted it.
+ */
+int stackOverflowed(void)
+{
+	return _sstack != STACK_PAINT_PATTERN;
+}
@@ -0,0 +1,25 @@
+/*
+ * stack.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Main stack usage. The startup code paints the stack area with
+ * STACK_PAINT_PATTERN before any code runs; the deepest word that no longer
+ * holds the pattern gives the high-water mark. The static worst case per
+ * entry point comes from tools/stack_report.py.
+ */
+
+#ifndef STACK_H_
+#define STACK_H_
+
+#include <stdint.h>
+
+#define STACK_PAINT_PATTERN 0xDEADBEEF // also in startup_stm32f40xx.s
+
+uint32_t stackGetSize(void);
+uint32_t stackGetHighWater(void);
+uint32_t stackGetFree(void);
+int stackOverflowed(void);
+
+#endif /* STACK_H_ */
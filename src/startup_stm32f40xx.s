@@ -37,8 +37,8 @@
   */
     
   .syntax unified
-  .cpu cortex-m3
-  .fpu softvfp
+  .cpu cortex-m4
+  .fpu fpv4-sp-d16
   .thumb
 
 .global  g_pfnVectors
@@ -72,33 +72,43 @@ defined in linker script */
 Reset_Handler:  
   ldr   sp, =_estack    /* Atollic update: set stack pointer */
 
+/* Enable the FPU (CP10 and CP11 full access) before any C code runs, code
+   built for the hard-float ABI may use FP registers anywhere */
+  ldr   r0, =0xE000ED88 /* SCB->CPACR */
+  ldr   r1, [r0]
+  orr   r1, r1, #(0xF << 20)
+  str   r1, [r0]
+  dsb
+  isb
+
+/* Paint the whole main stack area, nothing has been pushed yet. stack.c
+   measures the high-water mark from the words still holding the pattern */
+  ldr   r0, =_sstack
+  ldr   r1, =_estack
+  ldr   r2, =0xDEADBEEF /* STACK_PAINT_PATTERN */
+  bl    FillSection
+
 /* Copy the data segment initializers from flash to SRAM */  
-  movs  r1, #0
-  b  LoopCopyDataInit
+  ldr   r0, =_sidata
+  ldr   r1, =_sdata
+  ldr   r2, =_edata
+  bl    CopySection
+
+/* Copy the CCM-RAM initializers from flash to CCM-RAM */
+  ldr   r0, =_siccmram
+  ldr   r1, =_sccmram
+  ldr   r2, =_eccmram
+  bl    CopySection
 
-CopyDataInit:
-  ldr  r3, =_sidata
-  ldr  r3, [r3, r1]
-  str  r3, [r0, r1]
-  adds  r1, r1, #4
-    
-LoopCopyDataInit:
-  ldr  r0, =_sdata
-  ldr  r3, =_edata
-  adds  r2, r0, r1
-  cmp  r2, r3
-  bcc  CopyDataInit
-  ldr  r2, =_sbss
-  b  LoopFillZerobss
 /* Zero fill the bss segment. */  
-FillZerobss:
-  movs  r3, #0
-  str  r3, [r2], #4
-    
-LoopFillZerobss:
-  ldr  r3, = _ebss
-  cmp  r2, r3
-  bcc  FillZerobss
+  ldr   r0, =_sbss
+  ldr   r1, =_ebss
+  bl    ZeroSection
+
+/* Zero fill the CCM-RAM bss segment. */
+  ldr   r0, =_sccmbss
+  ldr   r1, =_eccmbss
+  bl    ZeroSection
 
 /* Call the clock system intitialization function.*/
   bl  SystemInit   
@@ -109,6 +119,67 @@ LoopFillZerobss:
   bx  lr    
 .size  Reset_Handler, .-Reset_Handler
 
+/**
+ * @brief  Copies a section from its load address. Section bounds are word
+ *         aligned by the linker script; 32 bytes are moved per LDM/STM
+ *         burst, the remainder one word at a time. Registers are not
+ *         preserved, this only runs before main.
+ * @param  r0: load address, r1: start address, r2: end address
+ * @retval None
+*/
+    .section  .text.CopySection,"ax",%progbits
+  .type  CopySection, %function
+CopySection:
+  subs  r3, r2, r1
+  cmp   r3, #32
+  blo   CopyWords
+  ldmia r0!, {r4-r11}
+  stmia r1!, {r4-r11}
+  b     CopySection
+CopyWords:
+  cmp   r1, r2
+  bhs   CopyDone
+  ldr   r3, [r0], #4
+  str   r3, [r1], #4
+  b     CopyWords
+CopyDone:
+  bx    lr
+.size  CopySection, .-CopySection
+
+/**
+ * @brief  Zero fills a word aligned section, 32 bytes per STM burst.
+ *         FillSection writes the word in r2 instead of zero.
+ * @param  r0: start address, r1: end address, r2: pattern (FillSection)
+ * @retval None
+*/
+    .section  .text.ZeroSection,"ax",%progbits
+  .type  ZeroSection, %function
+  .type  FillSection, %function
+ZeroSection:
+  movs  r2, #0
+FillSection:
+  mov   r3, r2
+  mov   r4, r2
+  mov   r5, r2
+  mov   r6, r2
+  mov   r7, r2
+  mov   r8, r2
+  mov   r9, r2
+FillBurst:
+  subs  r10, r1, r0
+  cmp   r10, #32
+  blo   FillWords
+  stmia r0!, {r2-r9}
+  b     FillBurst
+FillWords:
+  cmp   r0, r1
+  bhs   FillDone
+  str   r2, [r0], #4
+  b     FillWords
+FillDone:
+  bx    lr
+.size  ZeroSection, .-ZeroSection
+
 /**
  * @brief  This is the code that gets called when the processor receives an 
  *         unexpected interrupt.  This simply enters an infinite loop, preserving
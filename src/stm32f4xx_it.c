@@ -29,6 +29,12 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_it.h"
+#include "clock.h"
+#include "console.h"
+#include "timebase.h"
+#include "timer.h"
+#include "sched.h"
+#include "fault.h"
 
 /** @addtogroup Template_Project
   * @{
@@ -59,12 +65,10 @@ void NMI_Handler(void)
   * @param  None
   * @retval None
   */
-void HardFault_Handler(void)
+__attribute__((naked)) void HardFault_Handler(void)
 {
-  /* Go to infinite loop when Hard Fault exception occurs */
-  while (1)
-  {
-  }
+  /* Record the Hard Fault exception and reset, see fault.h */
+  FAULT_ENTRY(FAULT_HARD);
 }
 
 /**
@@ -72,12 +76,10 @@ void HardFault_Handler(void)
   * @param  None
   * @retval None
   */
-void MemManage_Handler(void)
+__attribute__((naked)) void MemManage_Handler(void)
 {
-  /* Go to infinite loop when Memory Manage exception occurs */
-  while (1)
-  {
-  }
+  /* Record the Memory Manage exception and reset, see fault.h */
+  FAULT_ENTRY(FAULT_MEMMANAGE);
 }
 
 /**
@@ -85,12 +87,10 @@ void MemManage_Handler(void)
   * @param  None
   * @retval None
   */
-void BusFault_Handler(void)
+__attribute__((naked)) void BusFault_Handler(void)
 {
-  /* Go to infinite loop when Bus Fault exception occurs */
-  while (1)
-  {
-  }
+  /* Record the Bus Fault exception and reset, see fault.h */
+  FAULT_ENTRY(FAULT_BUS);
 }
 
 /**
@@ -98,14 +98,13 @@ void BusFault_Handler(void)
   * @param  None
   * @retval None
   */
-void UsageFault_Handler(void)
+__attribute__((naked)) void UsageFault_Handler(void)
 {
-  /* Go to infinite loop when Usage Fault exception occurs */
-  while (1)
-  {
-  }
+  /* Record the Usage Fault exception and reset, see fault.h */
+  FAULT_ENTRY(FAULT_USAGE);
 }
 
+#ifndef USE_KERNEL
 /**
   * @brief  This function handles SVCall exception.
   * @param  None
@@ -114,6 +113,7 @@ void UsageFault_Handler(void)
 void SVC_Handler(void)
 {
 }
+#endif /* USE_KERNEL, kernel.c switches context */
 
 /**
   * @brief  This function handles Debug Monitor exception.
@@ -124,6 +124,7 @@ void DebugMon_Handler(void)
 {
 }
 
+#ifndef USE_KERNEL
 /**
   * @brief  This function handles PendSVC exception.
   * @param  None
@@ -131,7 +132,9 @@ void DebugMon_Handler(void)
   */
 void PendSV_Handler(void)
 {
+  schedDispatch();
 }
+#endif /* USE_KERNEL */
 
 /**
   * @brief  This function handles SysTick Handler.
@@ -140,7 +143,8 @@ void PendSV_Handler(void)
   */
 void SysTick_Handler(void)
 {
-/*  TimingDelay_Decrement(); */
+  timebaseTick();
+  timerTick();
 }
 
 /******************************************************************************/
@@ -150,6 +154,45 @@ void SysTick_Handler(void)
 /*  file (startup_stm32f40xx.s/startup_stm32f427x.s).                         */
 /******************************************************************************/
 
+#ifdef FAST_BOOT
+/**
+  * @brief  This function handles RCC interrupt request (clock ready flags).
+  * @param  None
+  * @retval None
+  */
+void RCC_IRQHandler(void)
+{
+  SystemClock_IRQHandler();
+}
+
+/**
+  * @brief  This function handles TIM7 interrupt request (HSE start-up
+  *         timeout).
+  * @param  None
+  * @retval None
+  */
+void TIM7_IRQHandler(void)
+{
+  SystemClock_IRQHandler();
+}
+#endif /* FAST_BOOT */
+
+/**
+  * @brief  These functions handle the console DMA interrupts (USART2 TX on
+  *         DMA1 stream 6, USART3 TX on DMA1 stream 3).
+  * @param  None
+  * @retval None
+  */
+void DMA1_Stream6_IRQHandler(void)
+{
+  consoleDmaIRQHandler();
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+  consoleDmaIRQHandler();
+}
+
 /**
   * @brief  This function handles PPP interrupt request.
   * @param  None
@@ -52,6 +52,8 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
+void DMA1_Stream3_IRQHandler(void);
+void DMA1_Stream6_IRQHandler(void);
 
 #ifdef __cplusplus
 }
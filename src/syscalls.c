@@ -0,0 +1,33 @@
+/*
+ * syscalls.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Newlib system calls used by tiny_printf.c.
+ */
+#include <errno.h>
+#include "console.h"
+#include "itm.h"
+
+#define STDOUT_FILENO 1
+#define STDERR_FILENO 2
+
+/**
+ * Sends stdout and stderr to the console, or to ITM stimulus port 0 when
+ * built with CONSOLE_ITM. Returns the number of bytes accepted, which is
+ * less than len when the console dropped output.
+ */
+int _write(int fd, char *str, int len)
+{
+	if (fd != STDOUT_FILENO && fd != STDERR_FILENO) {
+		errno = EBADF;
+		return -1;
+	}
+
+#ifdef CONSOLE_ITM
+	return itmWrite(str, len);
+#else
+	return consoleWrite(str, len);
+#endif
+}
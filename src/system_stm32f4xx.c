@@ -121,6 +121,7 @@
   */
 
 #include "stm32f4xx.h"
+#include "clock.h"
 
 /**
   * @}
@@ -163,6 +164,15 @@
 
 /******************************************************************************/
 
+/************************* Fast Boot Parameters *******************************/
+/*!< With FAST_BOOT, milliseconds given to HSE and the PLL to come up before
+     the bring-up gives up and stays on HSI. TIM7 counts them. */
+#ifndef FAST_BOOT_HSE_TIMEOUT
+#define FAST_BOOT_HSE_TIMEOUT  100
+#endif
+
+/******************************************************************************/
+
 /**
   * @}
   */
@@ -192,6 +202,11 @@
   */
 
 static void SetSysClock(void);
+static void SetSysClockPLL(void);
+static void SwitchSysClockToPLL(void);
+#ifdef FAST_BOOT
+static void StopHSETimeout(void);
+#endif /* FAST_BOOT */
 #ifdef DATA_IN_ExtSRAM
   static void SystemInit_ExtMemCtl(void); 
 #endif /* DATA_IN_ExtSRAM */
@@ -216,6 +231,10 @@ void SystemInit(void)
   /* FPU settings ------------------------------------------------------------*/
   #if (__FPU_PRESENT == 1) && (__FPU_USED == 1)
     SCB->CPACR |= ((3UL << 10*2)|(3UL << 11*2));  /* set CP10 and CP11 Full Access */
+
+    /* Automatic and lazy FP context stacking: exception entry only reserves
+       room for S0-S15/FPSCR, they are saved when the handler uses the FPU */
+    FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
   #endif
   /* Reset the RCC clock configuration to the default reset state ------------*/
   /* Set HSION bit */
@@ -240,9 +259,29 @@ void SystemInit(void)
   SystemInit_ExtMemCtl(); 
 #endif /* DATA_IN_ExtSRAM */
          
+#ifdef FAST_BOOT
+  /* Start main on HSI right away, HSE and PLL are brought up by the RCC
+     interrupt (see SystemClock_IRQHandler) ---------------------------------*/
+  SystemCoreClock = HSI_VALUE;
+  RCC->CIR |= RCC_CIR_HSERDYIE;
+  RCC->CR |= ((uint32_t)RCC_CR_HSEON);
+  NVIC_EnableIRQ(RCC_IRQn);
+
+  /* One-shot TIM7 at 1 kHz from HSI (APB1 not divided yet), in case HSE never
+     starts. Same priority as RCC, neither handler preempts the other. */
+  RCC->APB1ENR |= RCC_APB1ENR_TIM7EN;
+  TIM7->PSC = HSI_VALUE / 1000 - 1;
+  TIM7->ARR = FAST_BOOT_HSE_TIMEOUT - 1;
+  TIM7->EGR = TIM_EGR_UG;
+  TIM7->SR = 0;
+  TIM7->DIER = TIM_DIER_UIE;
+  TIM7->CR1 = TIM_CR1_OPM | TIM_CR1_CEN;
+  NVIC_EnableIRQ(TIM7_IRQn);
+#else
   /* Configure the System clock source, PLL Multiplier and Divider factors, 
      AHB/APBx prescalers and Flash settings ----------------------------------*/
   SetSysClock();
+#endif /* FAST_BOOT */
 
   /* Configure the Vector Table location add offset address ------------------*/
 #ifdef VECT_TAB_SRAM
@@ -372,42 +411,14 @@ static void SetSysClock(void)
 
   if (HSEStatus == (uint32_t)0x01)
   {
-    /* Select regulator voltage output Scale 1 mode, System frequency up to 168 MHz */
-    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
-    PWR->CR |= PWR_CR_VOS;
-
-    /* HCLK = SYSCLK / 1*/
-    RCC->CFGR |= RCC_CFGR_HPRE_DIV1;
-      
-    /* PCLK2 = HCLK / 2*/
-    RCC->CFGR |= RCC_CFGR_PPRE2_DIV2;
-    
-    /* PCLK1 = HCLK / 4*/
-    RCC->CFGR |= RCC_CFGR_PPRE1_DIV4;
-
-    /* Configure the main PLL */
-    RCC->PLLCFGR = PLL_M | (PLL_N << 6) | (((PLL_P >> 1) -1) << 16) |
-                   (RCC_PLLCFGR_PLLSRC_HSE) | (PLL_Q << 24);
-
-    /* Enable the main PLL */
-    RCC->CR |= RCC_CR_PLLON;
+    SetSysClockPLL();
 
     /* Wait till the main PLL is ready */
     while((RCC->CR & RCC_CR_PLLRDY) == 0)
     {
     }
    
-    /* Configure Flash prefetch, Instruction cache, Data cache and wait state */
-    FLASH->ACR = FLASH_ACR_PRFTEN |FLASH_ACR_ICEN |FLASH_ACR_DCEN |FLASH_ACR_LATENCY_5WS;
-
-    /* Select the main PLL as system clock source */
-    RCC->CFGR &= (uint32_t)((uint32_t)~(RCC_CFGR_SW));
-    RCC->CFGR |= RCC_CFGR_SW_PLL;
-
-    /* Wait till the main PLL is used as system clock source */
-    while ((RCC->CFGR & (uint32_t)RCC_CFGR_SWS ) != RCC_CFGR_SWS_PLL);
-    {
-    }
+    SwitchSysClockToPLL();
   }
   else
   { /* If HSE fails to start-up, the application will have wrong clock
@@ -416,6 +427,150 @@ static void SetSysClock(void)
 
 }
 
+/**
+  * @brief  Selects the regulator scale, configures the main PLL from HSE
+  *         and enables it. HSE must be ready.
+  * @param  None
+  * @retval None
+  */
+static void SetSysClockPLL(void)
+{
+  /* Select regulator voltage output Scale 1 mode, System frequency up to 168 MHz */
+  RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+  PWR->CR |= PWR_CR_VOS;
+
+  /* Configure the main PLL */
+  RCC->PLLCFGR = PLL_M | (PLL_N << 6) | (((PLL_P >> 1) -1) << 16) |
+                 (RCC_PLLCFGR_PLLSRC_HSE) | (PLL_Q << 24);
+
+  /* Enable the main PLL */
+  RCC->CR |= RCC_CR_PLLON;
+}
+
+/**
+  * @brief  Sets the flash wait states and bus prescalers for the PLL
+  *         frequency, then selects the PLL as system clock. The PLL must be
+  *         locked.
+  * @param  None
+  * @retval None
+  */
+static void SwitchSysClockToPLL(void)
+{
+  /* Configure Flash prefetch, Instruction cache, Data cache and wait state */
+  FLASH->ACR = FLASH_ACR_PRFTEN |FLASH_ACR_ICEN |FLASH_ACR_DCEN |FLASH_ACR_LATENCY_5WS;
+
+  /* HCLK = SYSCLK / 1*/
+  RCC->CFGR |= RCC_CFGR_HPRE_DIV1;
+    
+  /* PCLK2 = HCLK / 2*/
+  RCC->CFGR |= RCC_CFGR_PPRE2_DIV2;
+  
+  /* PCLK1 = HCLK / 4*/
+  RCC->CFGR |= RCC_CFGR_PPRE1_DIV4;
+
+  /* Select the main PLL as system clock source */
+  RCC->CFGR &= (uint32_t)((uint32_t)~(RCC_CFGR_SW));
+  RCC->CFGR |= RCC_CFGR_SW_PLL;
+
+  /* Wait till the main PLL is used as system clock source */
+  while ((RCC->CFGR & (uint32_t)RCC_CFGR_SWS ) != RCC_CFGR_SWS_PLL)
+  {
+  }
+}
+
+#ifdef FAST_BOOT
+static __IO uint32_t SystemClockReady = 0;
+
+/**
+  * @brief  Fast boot clock bring-up, called from RCC_IRQHandler and
+  *         TIM7_IRQHandler.
+  *         HSE ready: configure and start the PLL.
+  *         PLL locked: switch SYSCLK to it, update SystemCoreClock and call
+  *         SystemClockReady_Callback().
+  *         Timeout (TIM7) first: stop HSE and the PLL, stay on HSI and call
+  *         SystemClockReady_Callback() all the same.
+  * @param  None
+  * @retval None
+  */
+void SystemClock_IRQHandler(void)
+{
+  /* TIM7 reads as 0 once its clock is stopped */
+  if (TIM7->SR & TIM_SR_UIF)
+  {
+    StopHSETimeout();
+
+    RCC->CIR = RCC_CIR_HSERDYC | RCC_CIR_PLLRDYC;
+    NVIC_DisableIRQ(RCC_IRQn);
+    NVIC_ClearPendingIRQ(RCC_IRQn);
+    RCC->CR &= ~(RCC_CR_PLLON | RCC_CR_HSEON);
+
+    SystemCoreClockUpdate();
+    SystemClockReady = 1;
+
+    SystemClockReady_Callback();
+    return;
+  }
+
+  if (RCC->CIR & RCC_CIR_HSERDYF)
+  {
+    RCC->CIR = (RCC->CIR & ~RCC_CIR_HSERDYIE) | RCC_CIR_HSERDYC;
+
+    SetSysClockPLL();
+    RCC->CIR |= RCC_CIR_PLLRDYIE;
+  }
+
+  if (RCC->CIR & RCC_CIR_PLLRDYF)
+  {
+    RCC->CIR = (RCC->CIR & ~RCC_CIR_PLLRDYIE) | RCC_CIR_PLLRDYC;
+    NVIC_DisableIRQ(RCC_IRQn);
+    StopHSETimeout();
+
+    SwitchSysClockToPLL();
+    SystemCoreClockUpdate();
+    SystemClockReady = 1;
+
+    SystemClockReady_Callback();
+  }
+}
+
+/**
+  * @brief  Tells whether the bring-up is over.
+  * @param  None
+  * @retval 1 once SYSCLK runs from the PLL, or stays on HSI because HSE did
+  *         not start in time. 0 while the bring-up runs.
+  */
+uint32_t SystemClockIsReady(void)
+{
+  return SystemClockReady;
+}
+
+/**
+  * @brief  Called in interrupt context once the bring-up is over, SYSCLK on
+  *         the PLL or still on HSI. Override it to recompute peripheral
+  *         dividers.
+  * @param  None
+  * @retval None
+  */
+__attribute__((weak)) void SystemClockReady_Callback(void)
+{
+}
+
+/**
+  * @brief  Stops TIM7 and its interrupt, and TIM7 clock.
+  * @param  None
+  * @retval None
+  */
+static void StopHSETimeout(void)
+{
+  TIM7->CR1 = 0;
+  TIM7->DIER = 0;
+  TIM7->SR = 0;
+  NVIC_DisableIRQ(TIM7_IRQn);
+  NVIC_ClearPendingIRQ(TIM7_IRQn);
+  RCC->APB1ENR &= ~RCC_APB1ENR_TIM7EN;
+}
+#endif /* FAST_BOOT */
+
 /**
   * @brief  Setup the external memory controller. Called in startup_stm32f4xx.s 
   *          before jump to __main
@@ -0,0 +1,303 @@
+/*
+ * timebase.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stm32f4xx.h"
+#include "timebase.h"
+#include "clock.h"
+#include "critical.h"
+
+// Private function declarations
+
+static void updateReload(void);
+static uint32_t countedCycles(uint32_t *pending);
+static void credit(uint32_t cycles);
+static uint32_t periodUntil(uint64_t wakeup);
+
+// Private static variable definitions
+
+// whole ticks, and SysTick cycles counted past the last one
+static volatile uint64_t ticks = 0;
+static uint32_t partialCycles = 0;
+
+// length of the SysTick period being counted, LOAD + 1
+static uint32_t periodCycles = 0;
+
+// set when a pending SysTick interrupt was accounted for before it ran
+static uint32_t wrapAccounted = 0;
+static uint32_t cyclesPerTick = 0;
+
+// microseconds per cycle, 0.32 fixed point
+static uint32_t usPerCycle = 0;
+
+// 64-bit extension of CYCCNT, refreshed at least every SysTick period
+static volatile uint32_t cyclesHigh = 0;
+static volatile uint32_t lastCycles = 0;
+
+// CPU cycles per microsecond, 16.16 fixed point
+static uint32_t cyclesPerUs = 0;
+
+// Function definitions
+
+/**
+ * Starts SysTick at TIMEBASE_TICK_HZ and the DWT cycle counter.
+ */
+void timebaseInit(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	updateReload();
+	clockRegisterListener(updateReload);
+
+	// just above PendSV, timer callbacks preempt scheduler tasks
+	NVIC_SetPriority(SysTick_IRQn, (1 << __NVIC_PRIO_BITS) - 2);
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+/**
+ * Accounts for the SysTick period that just ended, called from
+ * SysTick_Handler.
+ */
+void timebaseTick(void)
+{
+	if (!wrapAccounted) {
+		credit(periodCycles);
+	}
+	wrapAccounted = 0;
+	timebaseGetCycles64();
+}
+
+/**
+ * Programs the next SysTick interrupt at the start of tick wakeup, instead
+ * of at the end of the current tick. The period is limited by the 24-bit
+ * counter (99 ms at 168 MHz), a later wakeup interrupts early and the
+ * caller programs the rest from the handler. A wakeup already reached
+ * interrupts at the next tick.
+ *
+ * When the running period already ends there, nothing changes. Otherwise
+ * the counter restarts from the new period; the few cycles spent doing so
+ * are lost to the tick (not to the DWT counter).
+ */
+void timebaseSetWakeup(uint64_t wakeup)
+{
+	uint32_t primask = criticalEnter();
+
+	uint32_t pending;
+	uint32_t counted = countedCycles(&pending);
+
+	// the running period started at the last credit
+	if ((!pending || wrapAccounted) && periodUntil(wakeup) == periodCycles) {
+		criticalExit(primask);
+		return;
+	}
+
+	credit(counted);
+	wrapAccounted |= pending;
+
+	periodCycles = periodUntil(wakeup);
+	SysTick->LOAD = periodCycles - 1;
+	SysTick->VAL = 0;
+
+	criticalExit(primask);
+}
+
+/**
+ * Milliseconds since timebaseInit().
+ */
+uint64_t timebaseGetTicks(void)
+{
+	uint32_t primask = criticalEnter();
+
+	uint32_t pending;
+	uint64_t result = ticks + (partialCycles + countedCycles(&pending)) / cyclesPerTick;
+
+	criticalExit(primask);
+	return result;
+}
+
+/**
+ * Microseconds since timebaseInit(), from the tick and the SysTick counter.
+ */
+uint64_t timebaseGetMicros(void)
+{
+	uint32_t primask = criticalEnter();
+
+	uint32_t pending;
+	uint64_t result = ticks * (1000000 / TIMEBASE_TICK_HZ);
+	uint32_t cycles = partialCycles + countedCycles(&pending);
+
+	criticalExit(primask);
+	return result + (((uint64_t) cycles * usPerCycle) >> 32);
+}
+
+/**
+ * Raw DWT cycle counter, for short intervals.
+ */
+uint32_t timebaseGetCycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+/**
+ * Cycle counter extended to 64 bits. Must run at least once every 2^32
+ * cycles, which the tick guarantees.
+ */
+uint64_t timebaseGetCycles64(void)
+{
+	uint32_t primask = criticalEnter();
+
+	uint32_t cycles = DWT->CYCCNT;
+	if (cycles < lastCycles) {
+		cyclesHigh++;
+	}
+	lastCycles = cycles;
+	uint64_t result = (uint64_t) cyclesHigh << 32 | cycles;
+
+	criticalExit(primask);
+	return result;
+}
+
+/**
+ * Cycles elapsed since start, correct across one counter wrap.
+ */
+uint32_t timebaseCyclesSince(uint32_t start)
+{
+	return DWT->CYCCNT - start;
+}
+
+/**
+ * Converts a cycle count to nanoseconds at the current clock.
+ */
+uint32_t timebaseCyclesToNanos(uint32_t cycles)
+{
+	if (cyclesPerUs == 0) {
+		return 0;
+	}
+	return (uint32_t) (((uint64_t) cycles << 16) * 1000 / cyclesPerUs);
+}
+
+/**
+ * Busy waits at least ns nanoseconds on the cycle counter, for bus timing
+ * requirements. The call itself already takes a few cycles.
+ */
+void timebaseDelayNs(uint32_t ns)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t cycles = (uint32_t) (((uint64_t) ns * cyclesPerUs) >> 16) / 1000 + 1;
+
+	while (DWT->CYCCNT - start < cycles);
+}
+
+/**
+ * Busy waits on the cycle counter, for delays below a millisecond or so.
+ */
+void timebaseDelayUs(uint32_t us)
+{
+	uint32_t start = DWT->CYCCNT;
+	uint32_t cycles = (uint32_t) (((uint64_t) us * cyclesPerUs) >> 16);
+
+	while (DWT->CYCCNT - start < cycles);
+}
+
+/**
+ * Waits at least ms milliseconds. Any interrupt, the tick included, may
+ * run meanwhile.
+ */
+void timebaseDelayMs(uint32_t ms)
+{
+	Timeout timeout;
+
+	timeoutStart(&timeout, ms * 1000);
+	while (!timeoutExpired(&timeout));
+}
+
+void timeoutStart(Timeout *timeout, uint32_t us)
+{
+	timeout->deadline = timebaseGetMicros() + us;
+}
+
+int timeoutExpired(const Timeout *timeout)
+{
+	return timebaseGetMicros() >= timeout->deadline;
+}
+
+/**
+ * Restarts at one tick per period when HCLK changes. The part of the
+ * current tick already counted is dropped.
+ */
+static void updateReload(void)
+{
+	uint32_t hclk = clockGetHCLK();
+	uint32_t primask = criticalEnter();
+
+	cyclesPerUs = (uint32_t) (((uint64_t) hclk << 16) / 1000000);
+	usPerCycle = (uint32_t) ((1000000ULL << 32) / hclk);
+	cyclesPerTick = hclk / TIMEBASE_TICK_HZ;
+	periodCycles = cyclesPerTick;
+	partialCycles = 0;
+
+	wrapAccounted = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+
+	SysTick->LOAD = periodCycles - 1;
+	SysTick->VAL = 0;
+
+	criticalExit(primask);
+}
+
+/**
+ * Cycles counted since the last credit, including a period that ended
+ * while its interrupt was masked. Sets pending when that interrupt has not
+ * run yet. Interrupts must be disabled.
+ */
+static uint32_t countedCycles(uint32_t *pending)
+{
+	uint32_t wrapped = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+	uint32_t value = SysTick->VAL;
+
+	// the wrap may happen between the two reads
+	if (!wrapped && (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+		wrapped = 1;
+		value = SysTick->VAL;
+	}
+
+	uint32_t cycles = SysTick->LOAD - value;
+	if (wrapped && !wrapAccounted) {
+		cycles += periodCycles;
+	}
+
+	*pending = wrapped != 0;
+	return cycles;
+}
+
+/**
+ * Adds counted cycles to the tick. Interrupts must be disabled, or called
+ * from the SysTick handler.
+ */
+static void credit(uint32_t cycles)
+{
+	uint32_t partial = partialCycles + cycles;
+	uint32_t whole = partial / cyclesPerTick;
+
+	ticks += whole;
+	partialCycles = partial - whole * cyclesPerTick;
+}
+
+/**
+ * SysTick cycles from the last credit to the start of tick wakeup, at least
+ * to the next tick and at most the whole counter.
+ */
+static uint32_t periodUntil(uint64_t wakeup)
+{
+	const uint32_t maxPeriod = SysTick_LOAD_RELOAD_Msk + 1;
+	uint64_t ahead = wakeup > ticks ? wakeup - ticks : 1;
+
+	if (ahead > maxPeriod / cyclesPerTick + 1) {
+		return maxPeriod;
+	}
+
+	uint32_t period = (uint32_t) ahead * cyclesPerTick - partialCycles;
+	return period < maxPeriod ? period : maxPeriod;
+}
@@ -0,0 +1,61 @@
+/*
+ * timebase.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Monotonic time.
+ *
+ * SysTick counts a 64-bit millisecond tick that never wraps. It interrupts
+ * every tick until timebaseSetWakeup() stretches its period to the next
+ * timer expiry (see timer.h); the tick then advances by the whole period
+ * at once. Within a period, the SysTick counter gives microseconds. The DWT
+ * cycle counter gives timestamps in CPU cycles, extended to 64 bits by
+ * timebaseGetCycles64(); it wraps every 2^32 cycles (25 s at 168 MHz),
+ * which the unsigned difference of timebaseCyclesSince() absorbs for
+ * shorter intervals. Everything follows clock level changes.
+ *
+ * Timeouts:
+ *
+ *   Timeout timeout;
+ *   timeoutStart(&timeout, 5000); // 5 ms
+ *   while (!ready()) {
+ *       if (timeoutExpired(&timeout)) {
+ *           return 1;
+ *       }
+ *   }
+ *
+ * Timeouts and delays need timebaseInit(); before it the clock does not
+ * advance and a timeout never expires.
+ */
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <stdint.h>
+
+#define TIMEBASE_TICK_HZ 1000
+
+typedef struct {
+	uint64_t deadline; // microseconds
+} Timeout;
+
+void timebaseInit(void);
+void timebaseTick(void);
+void timebaseSetWakeup(uint64_t wakeup);
+
+uint64_t timebaseGetTicks(void);
+uint64_t timebaseGetMicros(void);
+uint32_t timebaseGetCycles(void);
+uint64_t timebaseGetCycles64(void);
+uint32_t timebaseCyclesSince(uint32_t start);
+uint32_t timebaseCyclesToNanos(uint32_t cycles);
+
+void timebaseDelayNs(uint32_t ns);
+void timebaseDelayUs(uint32_t us);
+void timebaseDelayMs(uint32_t ms);
+
+void timeoutStart(Timeout *timeout, uint32_t us);
+int timeoutExpired(const Timeout *timeout);
+
+#endif /* TIMEBASE_H_ */
@@ -0,0 +1,377 @@
+/*
+ * timer.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stm32f4xx.h"
+#include "timer.h"
+#include "timebase.h"
+#include "sections.h"
+#include "critical.h"
+#include "log.h"
+
+#define LEVEL_BITS 6
+#define LEVEL_SLOTS (1 << LEVEL_BITS)
+#define LEVEL_MASK (LEVEL_SLOTS - 1)
+#define LEVEL_COUNT 4
+
+// farthest expiry the wheel holds, in ticks from its position
+#define WHEEL_RANGE (1UL << (LEVEL_BITS * LEVEL_COUNT))
+
+#define NO_WAKEUP UINT64_MAX
+
+// deferral state in Timer.flags
+#define FLAG_QUEUED 0x01 // linked in the deferred list
+#define FLAG_RUN    0x02 // callback due
+
+// Private function declarations
+
+static void insert(Timer *timer);
+static void link(Timer *timer, unsigned int level, unsigned int index);
+static void unlink(Timer *timer);
+static void cascade(unsigned int level, unsigned int index, uint32_t primask);
+static unsigned int nextSlot(unsigned int level, unsigned int from);
+static uint64_t nextWakeup(void);
+static void dispatch(Timer *timer);
+
+// Private static variable definitions
+
+// slot heads and a bit per occupied slot, scanned by nextSlot()
+CCMRAM_BSS static Timer *wheel[LEVEL_COUNT][LEVEL_SLOTS];
+CCMRAM_BSS static uint32_t occupied[LEVEL_COUNT][LEVEL_SLOTS / 32];
+
+// next tick the wheel processes
+static uint64_t wheelNext = 0;
+
+// tick of the SysTick interrupt programmed after the last pass
+static uint64_t wakeup = NO_WAKEUP;
+
+// callbacks waiting for timerRunDeferred()
+static Timer *deferredHead = 0;
+static Timer *deferredTail = 0;
+
+// Function definitions
+
+void timerInit(Timer *timer, TimerCallback callback, void *arg, TimerMode mode)
+{
+	timer->next = 0;
+	timer->link = 0;
+	timer->deferredNext = 0;
+	timer->expires = 0;
+	timer->period = 0;
+	timer->callback = callback;
+	timer->arg = arg;
+	timer->mode = mode;
+	timer->slot = 0;
+	timer->flags = 0;
+	timer->overruns = 0;
+}
+
+/**
+ * Arms the timer delay ticks from now, then every period ticks (0 for a
+ * one-shot). A timer already running is rearmed.
+ */
+void timerStart(Timer *timer, uint32_t delay, uint32_t period)
+{
+	uint32_t primask = criticalEnter();
+
+	if (timer->link) {
+		unlink(timer);
+	}
+
+	timer->expires = timebaseGetTicks() + (delay ? delay : 1);
+	timer->period = period;
+	insert(timer);
+
+	// the interrupt is programmed for later, bring it forward
+	if (timer->expires < wakeup) {
+		wakeup = timer->expires;
+		timebaseSetWakeup(wakeup);
+	}
+
+	criticalExit(primask);
+}
+
+/**
+ * Disarms the timer and cancels a deferred callback not run yet.
+ */
+void timerStop(Timer *timer)
+{
+	uint32_t primask = criticalEnter();
+
+	if (timer->link) {
+		unlink(timer);
+	}
+	timer->flags &= ~FLAG_RUN;
+
+	criticalExit(primask);
+}
+
+int timerIsActive(const Timer *timer)
+{
+	return timer->link != 0;
+}
+
+/**
+ * Advances the wheel to the current tick, runs or defers what expired and
+ * programs the next wakeup. Called from SysTick_Handler after
+ * timebaseTick().
+ */
+void timerTick(void)
+{
+	uint64_t now = timebaseGetTicks();
+	uint32_t primask = criticalEnter();
+
+	while (wheelNext <= now) {
+		unsigned int index = wheelNext & LEVEL_MASK;
+		Timer *timer;
+
+		// the lowest level wrapped, redistribute the next slot above
+		if (index == 0) {
+			for (unsigned int level = 1; level < LEVEL_COUNT; level++) {
+				unsigned int upper = (wheelNext >> (LEVEL_BITS * level)) & LEVEL_MASK;
+				cascade(level, upper, primask);
+				if (upper != 0) {
+					break;
+				}
+			}
+		}
+
+		while ((timer = wheel[0][index]) != 0) {
+			unlink(timer);
+			if (timer->period) {
+				timer->expires += timer->period;
+				if (timer->expires <= wheelNext) {
+					timer->expires = wheelNext + 1; // late, skip the missed periods
+				}
+				insert(timer);
+			}
+
+			// callbacks run with interrupts enabled and may start or stop timers
+			criticalExit(primask);
+			dispatch(timer);
+			primask = criticalEnter();
+		}
+
+		// skip the empty slots up to the next occupied one or the next cascade
+		uint64_t skip = wheelNext - index + nextSlot(0, index + 1);
+		wheelNext = skip <= now ? skip : now + 1;
+	}
+
+	wakeup = nextWakeup();
+	timebaseSetWakeup(wakeup);
+
+	criticalExit(primask);
+}
+
+/**
+ * Runs the deferred callbacks, from the main loop. Returns how many ran.
+ */
+unsigned int timerRunDeferred(void)
+{
+	unsigned int count = 0;
+
+	while (1) {
+		uint32_t primask = criticalEnter();
+
+		Timer *timer = deferredHead;
+		if (timer == 0) {
+			criticalExit(primask);
+			break;
+		}
+		deferredHead = timer->deferredNext;
+		if (deferredHead == 0) {
+			deferredTail = 0;
+		}
+
+		uint8_t run = timer->flags & FLAG_RUN;
+		timer->flags = 0;
+
+		criticalExit(primask);
+
+		if (run) {
+			timer->callback(timer->arg);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+int timerHasDeferred(void)
+{
+	return deferredHead != 0;
+}
+
+/**
+ * One pass of an idle loop: runs the deferred callbacks, drains the log,
+ * then sleeps until the next interrupt. The check and WFI run with
+ * interrupts masked, so a callback deferred in between wakes the core
+ * instead of waiting for the next interrupt, which may be a whole tickless
+ * period away. Log records written meanwhile wait for the next pass.
+ */
+void timerIdle(void)
+{
+	timerRunDeferred();
+	logDrain();
+
+	__disable_irq();
+	if (!timerHasDeferred()) {
+		__DSB();
+		__WFI();
+	}
+	__enable_irq();
+}
+
+/**
+ * Links the timer in the slot of its expiry, relative to the wheel
+ * position. Interrupts must be disabled.
+ */
+static void insert(Timer *timer)
+{
+	uint64_t expires = timer->expires;
+	unsigned int level = 0;
+
+	if (expires < wheelNext) {
+		expires = wheelNext;
+	}
+	if (expires - wheelNext >= WHEEL_RANGE) {
+		expires = wheelNext + WHEEL_RANGE - 1; // cascades again from there
+	}
+
+	uint32_t delta = (uint32_t) (expires - wheelNext);
+	while (level < LEVEL_COUNT - 1 && delta >= (1UL << (LEVEL_BITS * (level + 1)))) {
+		level++;
+	}
+
+	link(timer, level, (expires >> (LEVEL_BITS * level)) & LEVEL_MASK);
+}
+
+static void link(Timer *timer, unsigned int level, unsigned int index)
+{
+	Timer **head = &wheel[level][index];
+
+	timer->next = *head;
+	if (timer->next) {
+		timer->next->link = &timer->next;
+	}
+	*head = timer;
+	timer->link = head;
+	timer->slot = level * LEVEL_SLOTS + index;
+
+	occupied[level][index / 32] |= 1UL << (index % 32);
+}
+
+static void unlink(Timer *timer)
+{
+	unsigned int level = timer->slot / LEVEL_SLOTS;
+	unsigned int index = timer->slot % LEVEL_SLOTS;
+
+	*timer->link = timer->next;
+	if (timer->next) {
+		timer->next->link = timer->link;
+	}
+	timer->link = 0;
+
+	if (wheel[level][index] == 0) {
+		occupied[level][index / 32] &= ~(1UL << (index % 32));
+	}
+}
+
+/**
+ * Moves the timers of a slot to the levels below, one at a time: interrupts
+ * are unmasked (back to primask) between timers, so a slot holding any
+ * number of timers masks them for a single move. The slot never receives
+ * a timer while it cascades, its range lies below the level.
+ */
+static void cascade(unsigned int level, unsigned int index, uint32_t primask)
+{
+	Timer *timer;
+
+	while ((timer = wheel[level][index]) != 0) {
+		unlink(timer);
+		insert(timer);
+
+		criticalExit(primask);
+		criticalEnter();
+	}
+}
+
+/**
+ * First occupied slot of the level from index from, or LEVEL_SLOTS.
+ */
+static unsigned int nextSlot(unsigned int level, unsigned int from)
+{
+	for (unsigned int word = from / 32; word < LEVEL_SLOTS / 32; word++) {
+		uint32_t bits = occupied[level][word];
+		if (word == from / 32) {
+			bits &= ~0UL << (from % 32);
+		}
+		if (bits) {
+			return word * 32 + __builtin_ctz(bits);
+		}
+	}
+	return LEVEL_SLOTS;
+}
+
+/**
+ * Tick of the next occupied slot of the lowest level, or of the next
+ * cascade when it comes first and the levels above hold timers.
+ */
+static uint64_t nextWakeup(void)
+{
+	unsigned int index = wheelNext & LEVEL_MASK;
+	unsigned int slot = nextSlot(0, index);
+	uint64_t next = NO_WAKEUP;
+
+	if (slot < LEVEL_SLOTS) {
+		next = wheelNext - index + slot;
+	} else if ((slot = nextSlot(0, 0)) < LEVEL_SLOTS) {
+		next = wheelNext - index + LEVEL_SLOTS + slot; // slots behind are the next round
+	}
+
+	// a position on a level boundary has not cascaded yet
+	uint64_t boundary = (wheelNext + LEVEL_MASK) & ~(uint64_t) LEVEL_MASK;
+
+	if (boundary < next) {
+		for (unsigned int level = 1; level < LEVEL_COUNT; level++) {
+			if (nextSlot(level, 0) < LEVEL_SLOTS) {
+				return boundary;
+			}
+		}
+	}
+
+	return next;
+}
+
+/**
+ * Runs the callback of an expired timer or queues it for the main loop.
+ */
+static void dispatch(Timer *timer)
+{
+	if (timer->mode == TIMER_ISR) {
+		timer->callback(timer->arg);
+		return;
+	}
+
+	uint32_t primask = criticalEnter();
+
+	if (timer->flags & FLAG_RUN) {
+		timer->overruns++;
+	}
+	timer->flags |= FLAG_RUN;
+
+	if (!(timer->flags & FLAG_QUEUED)) {
+		timer->flags |= FLAG_QUEUED;
+		timer->deferredNext = 0;
+		if (deferredTail) {
+			deferredTail->deferredNext = timer;
+		} else {
+			deferredHead = timer;
+		}
+		deferredTail = timer;
+	}
+
+	criticalExit(primask);
+}
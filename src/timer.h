@@ -0,0 +1,76 @@
+/*
+ * timer.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Software timers on a hierarchical timer wheel.
+ *
+ * Four levels of 64 slots cover 1 ms, 64 ms, 4 s and 4.4 min per slot, up
+ * to 2^24 ticks (4.6 h); longer delays are placed at the far end and
+ * cascade again. A timer sits in the slot of its expiry, linked in both
+ * directions, so starting and stopping are O(1) whatever the number of
+ * timers. When the lowest level wraps, the next slot of the level above is
+ * redistributed below it.
+ *
+ * The wheel advances from SysTick_Handler. After each pass it programs the
+ * next SysTick interrupt at the next occupied slot (or at the next cascade)
+ * with timebaseSetWakeup(), so an idle system is not woken every tick.
+ *
+ * Callbacks run either in the SysTick handler (TIMER_ISR, preempting only
+ * scheduler tasks, keep them short) or later from the idle loop through
+ * timerRunDeferred() (the default), which timerIdle() calls with logDrain()
+ * before sleeping. A deferred timer that fires again before its callback
+ * ran counts an overrun and runs once.
+ *
+ * Usage:
+ *
+ *   static Timer sampleTimer;
+ *
+ *   timerInit(&sampleTimer, sample, 0, TIMER_DEFERRED);
+ *   timerStart(&sampleTimer, 10, 10); // every 10 ms
+ *
+ *   schedRun(); // idle loop, runs timerRunDeferred()
+ *
+ * Every function may be called from interrupt handlers, including the
+ * callbacks themselves. Interrupts stay masked for one timer at a time,
+ * however many expire or cascade in a pass.
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <stdint.h>
+
+typedef void (*TimerCallback)(void *arg);
+
+typedef enum {
+	TIMER_DEFERRED = 0, // callback from timerRunDeferred()
+	TIMER_ISR = 1       // callback from the SysTick handler
+} TimerMode;
+
+typedef struct Timer {
+	struct Timer *next;
+	struct Timer **link;         // field pointing to this timer, 0 when stopped
+	struct Timer *deferredNext;
+	uint64_t expires;            // tick
+	uint32_t period;             // ticks, 0 for one-shot
+	TimerCallback callback;
+	void *arg;
+	uint8_t mode;
+	uint8_t slot;                // level * 64 + index
+	volatile uint8_t flags;      // deferral state, see timer.c
+	uint16_t overruns;
+} Timer;
+
+void timerInit(Timer *timer, TimerCallback callback, void *arg, TimerMode mode);
+void timerStart(Timer *timer, uint32_t delay, uint32_t period);
+void timerStop(Timer *timer);
+int timerIsActive(const Timer *timer);
+
+void timerTick(void);
+unsigned int timerRunDeferred(void);
+int timerHasDeferred(void);
+void timerIdle(void);
+
+#endif /* TIMER_H_ */
@@ -14,7 +14,7 @@ Abstract: Atollic TrueSTUDIO Minimal iprintf/siprintf/fiprintf
           conversion specifier.
 
           The following conversion specifiers are supported
-          cdisuxX%
+          cdisuxXfFeEgGq%
 
           Usage:
           c    character
@@ -22,10 +22,38 @@ Abstract: Atollic TrueSTUDIO Minimal iprintf/siprintf/fiprintf
           s    character string
           u    unsigned integer as decimal
           x,X  unsigned integer as hexadecimal (uppercase letter)
+          f,F  double as [-]ddd.ddd
+          e,E  double as [-]d.ddde[+-]dd
+          g,G  double as f or e, whichever is shorter for the precision,
+               without trailing zeros
+          qN   signed 32 bits fixed-point integer with N fractional bits
+               (Q format, N from 0 to 31), printed as [-]ddd.ddd,
+               e.g. %.4q15 for a Q15 value
           %    % is written (conversion specification is '%%')
 
+          A minimum field width may follow the %, optionally preceded
+          by the flag - (left-justify) or 0 (pad numbers with zeros
+          after the sign), e.g. %08X, %-10s, %5d.
+
+          A precision (.N) gives the digits after the decimal point
+          for f, e and q, the significant digits for g. It defaults to
+          6 and is limited to TS_MAX_PRECISION (one less for e). %f
+          values of 2^32 and more are printed as %e, and so are %g
+          values that would need more fraction digits than the limit.
+          Rounding is to nearest, ties to even. Float conversions use
+          no heap and a fixed buffer on the stack; double arithmetic
+          comes from libgcc.
+
           Note:
-          Character padding is not supported
+          Integers are converted without division: decimal two digits
+          at a time through a lookup table and a reciprocal multiply,
+          hexadecimal with shifts and masks.
+
+          The format string is walked once. Stream output goes into a
+          ring buffer per stream (stdout, stderr), passed to _write when
+          a newline is printed or TS_FLUSH_THRESHOLD characters are
+          waiting. Stream functions are not reentrant, do not call them
+          from interrupt handlers.
 
 The MIT License (MIT)
 Copyright (c) 2019 STMicroelectronics
@@ -64,157 +92,636 @@ __attribute__ ((alias("siprintf"))) int sprintf(char* str, const char *fmt, ...)
 /* External function prototypes (defined in syscalls.c) */
 extern int _write(int fd, char *str, int len);
 
+/* Stream buffering, the size must be a power of two */
+#define TS_STREAM_BUFFER_SIZE 128
+#define TS_FLUSH_THRESHOLD    96
+
+/* Floating point and fixed-point conversions */
+#define TS_DEFAULT_PRECISION  6
+#define TS_MAX_PRECISION      9  /* 8 for the exponent form */
+
+/* Private types */
+typedef struct
+{
+	int fd;
+	unsigned int head;   /* oldest waiting character */
+	unsigned int count;  /* characters waiting */
+	char buffer[TS_STREAM_BUFFER_SIZE];
+} ts_stream;
+
+typedef struct ts_output
+{
+	void (*put)(struct ts_output *out, char c);
+	char *buf;           /* string output */
+	ts_stream *stream;   /* stream output */
+	int length;
+} ts_output;
+
 /* Private function prototypes */
 void ts_itoa(char **buf, unsigned int d, int base);
+static void ts_utoa(char **buf, unsigned int d, int mindigits);
 int ts_formatstring(char *buf, const char *fmt, va_list va);
-int ts_formatlength(const char *fmt, va_list va);
+int ts_format(ts_output *out, const char *fmt, va_list va);
+int ts_vfprintf(int fd, const char *fmt, va_list va);
+int ts_flush(int fd);
+
+/* Digit tables */
+static const char ts_hexdigits[16] = {
+	'0', '1', '2', '3', '4', '5', '6', '7',
+	'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+static const char ts_digitpairs[200] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const unsigned int ts_powersof10[9] = {
+	10, 100, 1000, 10000, 100000,
+	1000000, 10000000, 100000000, 1000000000
+};
+
+/* 10^(2^i), to bring a double to [1, 10) in at most 9 steps */
+static const double ts_binarypowersof10[9] = {
+	1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256
+};
+
+/* Private variables */
+static ts_stream ts_stdout = { 1, 0, 0, {0} };
+static ts_stream ts_stderr = { 2, 0, 0, {0} };
 
 /* Private functions */
 
 /**
 **---------------------------------------------------------------------------
-**  Abstract: Convert integer to ascii
-**  Returns:  void
+**  Abstract: Convert integer to ascii, base 10 or 16 (any other base is
+**            treated as 10). The digit count is known beforehand and the
+**            digits are stored from the last one, without division
+**  Returns:  void, *buf is advanced past the digits
 **---------------------------------------------------------------------------
 */
 void ts_itoa(char **buf, unsigned int d, int base)
 {
-	int div = 1;
-	while (d/div >= base)
-		div *= base;
+	char *p;
+	int length = 1;
+
+	if (base == 16)
+	{
+		/* 4 bits per digit */
+		if (d)
+			length = (35 - __builtin_clz(d)) >> 2;
+		p = *buf + length;
+		*buf = p;
+		do
+		{
+			*--p = ts_hexdigits[d & 0xF];
+			d >>= 4;
+		} while (d);
+		return;
+	}
+
+	ts_utoa(buf, d, 1);
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Convert unsigned integer to decimal ascii, with at least
+**            mindigits digits (leading zeros)
+**  Returns:  void, *buf is advanced past the digits
+**---------------------------------------------------------------------------
+*/
+static void ts_utoa(char **buf, unsigned int d, int mindigits)
+{
+	char *p;
+	int length = 1;
+
+	while (length < 10 && d >= ts_powersof10[length - 1])
+		length++;
+	for (; mindigits > length; mindigits--)
+		*(*buf)++ = '0';
+	p = *buf + length;
+	*buf = p;
+
+	while (d >= 100)
+	{
+		/* d / 100, exact for any 32 bits value */
+		unsigned int q = (unsigned int)(((unsigned long long)d * 0x51EB851FU) >> 37);
+		unsigned int r = d - q * 100;
+		p -= 2;
+		p[0] = ts_digitpairs[2 * r];
+		p[1] = ts_digitpairs[2 * r + 1];
+		d = q;
+	}
+	if (d >= 10)
+	{
+		p -= 2;
+		p[0] = ts_digitpairs[2 * d];
+		p[1] = ts_digitpairs[2 * d + 1];
+	}
+	else
+	{
+		*--p = (char)('0' + d);
+	}
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Scales a positive finite double to [1, 10)
+**  Returns:  Its decimal exponent
+**---------------------------------------------------------------------------
+*/
+static int ts_normalize(double *x)
+{
+	int exponent = 0;
+	int i;
+
+	if (*x >= 10.0)
+	{
+		for (i = 8; i >= 0; i--)
+		{
+			if (*x >= ts_binarypowersof10[i])
+			{
+				*x /= ts_binarypowersof10[i];
+				exponent += 1 << i;
+			}
+		}
+	}
+	else if (*x < 1.0)
+	{
+		for (i = 8; i >= 0; i--)
+		{
+			if (*x * ts_binarypowersof10[i] < 10.0)
+			{
+				*x *= ts_binarypowersof10[i];
+				exponent -= 1 << i;
+			}
+		}
+	}
+	return exponent;
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Rounds a non-negative double below 2^32 to the nearest
+**            integer, ties to even like the newlib printf
+**  Returns:  Rounded value
+**---------------------------------------------------------------------------
+*/
+static unsigned int ts_round(double x)
+{
+	unsigned int n = (unsigned int)x;
+	double rest = x - n;
+	if (rest > 0.5 || (rest == 0.5 && (n & 1)))
+		n++;
+	return n;
+}
 
-	while (div != 0)
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Writes the fraction digits, without trailing zeros if strip
+**  Returns:  void, *buf is advanced past the written characters
+**---------------------------------------------------------------------------
+*/
+static void ts_fraction(char **buf, unsigned int frac, int precision, int strip)
+{
+	if (strip)
 	{
-		int num = d/div;
-		d = d%div;
-		div /= base;
-		if (num > 9)
-			*((*buf)++) = (num-10) + 'A';
+		for (; precision > 0 && frac % 10 == 0; precision--)
+			frac /= 10;
+	}
+	if (precision > 0)
+	{
+		*(*buf)++ = '.';
+		ts_utoa(buf, frac, precision);
+	}
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Convert a positive double to ascii, conversion f, e or g
+**            (uppercase for E and G exponents and INF/NAN)
+**  Returns:  void, *buf is advanced past the written characters
+**---------------------------------------------------------------------------
+*/
+static void ts_ftoa(char **buf, double x, int precision, char conversion)
+{
+	char upper = (conversion >= 'A' && conversion <= 'Z');
+	char form = conversion | 0x20;
+	int strip = 0;
+	int exponent = 0;
+	unsigned int scale;
+	unsigned int digits;
+	double m;
+
+	if (x != x || x > 1.7976931348623157e308)
+	{
+		const char *text = (x != x) ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf");
+		while (*text)
+			*(*buf)++ = *text++;
+		return;
+	}
+
+	if (form == 'g')
+	{
+		/* Decimal exponent of the value rounded to precision digits */
+		if (precision == 0)
+			precision = 1;
+		if (x != 0.0)
+		{
+			m = x;
+			exponent = ts_normalize(&m);
+			scale = precision > 1 ? ts_powersof10[precision - 2] : 1;
+			if (ts_round(m * scale) >= scale * 10)
+				exponent++;
+		}
+		strip = 1;
+		if (exponent >= -4 && exponent < precision
+				&& precision - exponent - 1 <= TS_MAX_PRECISION)
+		{
+			form = 'f';
+			precision -= exponent + 1;
+		}
 		else
-			*((*buf)++) = num + '0';
+		{
+			form = 'e';
+			precision -= 1;
+		}
 	}
+
+	scale = precision ? ts_powersof10[precision - 1] : 1;
+
+	if (form == 'f' && x < 4294967295.0)
+	{
+		unsigned int integer = precision ? (unsigned int)x : ts_round(x);
+		unsigned int frac = precision ? ts_round((x - integer) * scale) : 0;
+		if (frac >= scale)
+		{
+			frac -= scale;
+			integer++;
+		}
+		ts_utoa(buf, integer, 1);
+		ts_fraction(buf, frac, precision, strip);
+		return;
+	}
+
+	/* Exponent form, d.ddd times 10^exponent, the digits fit 32 bits */
+	if (precision > TS_MAX_PRECISION - 1)
+	{
+		precision = TS_MAX_PRECISION - 1;
+		scale = ts_powersof10[precision - 1];
+	}
+	m = x;
+	exponent = (x != 0.0) ? ts_normalize(&m) : 0;
+	digits = ts_round(m * scale);
+	if (digits >= scale * 10)
+	{
+		digits = scale;
+		exponent++;
+	}
+	*(*buf)++ = (char)('0' + digits / scale);
+	ts_fraction(buf, digits % scale, precision, strip);
+	*(*buf)++ = upper ? 'E' : 'e';
+	if (exponent < 0)
+	{
+		*(*buf)++ = '-';
+		exponent = -exponent;
+	}
+	else
+	{
+		*(*buf)++ = '+';
+	}
+	ts_utoa(buf, exponent, 2);
 }
 
 /**
 **---------------------------------------------------------------------------
-**  Abstract: Writes arguments va to buffer buf according to format fmt
-**  Returns:  Length of string
+**  Abstract: Convert the magnitude of a Q format value with fracbits
+**            fractional bits to ascii, using integer arithmetic only
+**  Returns:  void, *buf is advanced past the written characters
 **---------------------------------------------------------------------------
 */
-int ts_formatstring(char *buf, const char *fmt, va_list va)
+static void ts_qtoa(char **buf, unsigned int magnitude, int fracbits, int precision)
+{
+	unsigned int scale = precision ? ts_powersof10[precision - 1] : 1;
+	unsigned int integer = fracbits < 32 ? magnitude >> fracbits : 0;
+	unsigned int frac = 0;
+
+	if (fracbits > 0)
+	{
+		unsigned long long bits = magnitude & (0xFFFFFFFFU >> (32 - fracbits));
+		frac = (unsigned int)((bits * scale + (1ULL << (fracbits - 1))) >> fracbits);
+		if (frac >= scale)
+		{
+			frac -= scale;
+			integer++;
+		}
+	}
+	ts_utoa(buf, integer, 1);
+	ts_fraction(buf, frac, precision, 0);
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Writes count copies of character c to the output
+**  Returns:  void
+**---------------------------------------------------------------------------
+*/
+static void ts_pad(ts_output *out, char c, int count)
 {
-	char *start_buf = buf;
+	while (count-- > 0)
+		out->put(out, c);
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Passes the waiting characters of a stream to _write
+**  Returns:  0 if successful, EOF otherwise
+**---------------------------------------------------------------------------
+*/
+static int ts_streamflush(ts_stream *stream)
+{
+	int res = 0;
+	while (stream->count)
+	{
+		/* Contiguous part, the rest has wrapped to the start */
+		unsigned int length = TS_STREAM_BUFFER_SIZE - stream->head;
+		if (length > stream->count)
+			length = stream->count;
+
+		if (_write(stream->fd, &stream->buffer[stream->head], length) != (int)length)
+		{
+			/* Drop what is left rather than retrying forever */
+			stream->head = 0;
+			stream->count = 0;
+			res = EOF;
+			break;
+		}
+		stream->head = (stream->head + length) & (TS_STREAM_BUFFER_SIZE - 1);
+		stream->count -= length;
+	}
+	return res;
+}
+
+static void ts_streamput(ts_stream *stream, char c)
+{
+	stream->buffer[(stream->head + stream->count) & (TS_STREAM_BUFFER_SIZE - 1)] = c;
+	stream->count++;
+	if (c == '\n' || stream->count >= TS_FLUSH_THRESHOLD)
+		ts_streamflush(stream);
+}
+
+static ts_stream *ts_getstream(int fd)
+{
+	if (fd == 1)
+		return &ts_stdout;
+	if (fd == 2)
+		return &ts_stderr;
+	return 0;
+}
+
+/* Output functions for ts_format */
+static void ts_putstring(ts_output *out, char c)
+{
+	*out->buf++ = c;
+	out->length++;
+}
+
+static void ts_putstream(ts_output *out, char c)
+{
+	ts_streamput(out->stream, c);
+	out->length++;
+}
+
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Formats arguments va according to format fmt, each character
+**            is passed to the output as it is produced
+**  Returns:  Length of the output
+**---------------------------------------------------------------------------
+*/
+int ts_format(ts_output *out, const char *fmt, va_list va)
+{
+	char digits[24];
+	char *end;
+	const char *body;
+	int length;
+	char sign;
+	int left;
+	char fill;
+	int width;
+	int precision;
+
 	while(*fmt)
 	{
 		/* Character needs formating? */
 		if (*fmt == '%')
 		{
+			left = 0;
+			fill = ' ';
+			width = 0;
+			sign = 0;
+
+			/* Flags and minimum field width */
+			for (;; fmt++)
+			{
+				if (fmt[1] == '-')
+					left = 1;
+				else if (fmt[1] == '0')
+					fill = '0';
+				else
+					break;
+			}
+			while (fmt[1] >= '0' && fmt[1] <= '9')
+			{
+				width = width * 10 + (*++fmt - '0');
+			}
+
+			/* Precision */
+			precision = TS_DEFAULT_PRECISION;
+			if (fmt[1] == '.')
+			{
+				fmt++;
+				precision = 0;
+				while (fmt[1] >= '0' && fmt[1] <= '9')
+				{
+					precision = precision * 10 + (*++fmt - '0');
+				}
+			}
+			if (precision > TS_MAX_PRECISION)
+				precision = TS_MAX_PRECISION;
+
+			end = digits;
+			body = digits;
 			switch (*(++fmt))
 			{
 			  case 'c':
-				*buf++ = va_arg(va, int);
+				digits[0] = (char)va_arg(va, int);
+				end = digits + 1;
+				fill = ' ';
 				break;
 			  case 'd':
 			  case 'i':
 				{
 					signed int val = va_arg(va, signed int);
+					unsigned int magnitude = (unsigned int)val;
 					if (val < 0)
 					{
-						val *= -1;
-						*buf++ = '-';
+						magnitude = 0U - magnitude;
+						sign = '-';
 					}
-					ts_itoa(&buf, val, 10);
+					ts_itoa(&end, magnitude, 10);
 				}
 				break;
 			  case 's':
+				body = va_arg(va, char *);
+				fill = ' ';
+				if (!width)
 				{
-					char * arg = va_arg(va, char *);
-					while (*arg)
-					{
-						*buf++ = *arg++;
-					}
+					/* No padding, copy without measuring first */
+					while (*body)
+						out->put(out, *body++);
 				}
+				end = (char *)body + strlen(body);
 				break;
 			  case 'u':
-					ts_itoa(&buf, va_arg(va, unsigned int), 10);
+					ts_itoa(&end, va_arg(va, unsigned int), 10);
 				break;
 			  case 'x':
 			  case 'X':
-					ts_itoa(&buf, va_arg(va, int), 16);
+					ts_itoa(&end, va_arg(va, int), 16);
+				break;
+			  case 'f':
+			  case 'F':
+			  case 'e':
+			  case 'E':
+			  case 'g':
+			  case 'G':
+				{
+					double val = va_arg(va, double);
+					if (val < 0)
+					{
+						val = -val;
+						sign = '-';
+					}
+					ts_ftoa(&end, val, precision, *fmt);
+				}
+				break;
+			  case 'q':
+				{
+					signed int val = va_arg(va, signed int);
+					unsigned int magnitude = (unsigned int)val;
+					int fracbits = 0;
+					/* One or two digits, as long as the count is at most 31 */
+					if (fmt[1] >= '0' && fmt[1] <= '9')
+					{
+						fracbits = *++fmt - '0';
+						if (fmt[1] >= '0' && fmt[1] <= '9'
+								&& fracbits * 10 + (fmt[1] - '0') <= 31)
+							fracbits = fracbits * 10 + (*++fmt - '0');
+					}
+					if (val < 0)
+					{
+						magnitude = 0U - magnitude;
+						sign = '-';
+					}
+					ts_qtoa(&end, magnitude, fracbits, precision);
+				}
 				break;
 			  case '%':
-				  *buf++ = '%';
+				  out->put(out, '%');
 				  break;
+			  case 0:
+				  /* Lone % at the end of the format */
+				  return out->length;
 			}
+
+			length = (int)(end - body) + (sign ? 1 : 0);
+			if (!left && fill == ' ')
+				ts_pad(out, ' ', width - length);
+			if (sign)
+				out->put(out, sign);
+			if (!left && fill == '0')
+				ts_pad(out, '0', width - length);
+			while (body < end)
+				out->put(out, *body++);
+			if (left)
+				ts_pad(out, ' ', width - length);
 			fmt++;
 		}
 		/* Else just copy */
 		else
 		{
-			*buf++ = *fmt++;
+			out->put(out, *fmt++);
 		}
 	}
-	*buf = 0;
 
-	return (int)(buf - start_buf);
+	return out->length;
 }
 
+/**
+**---------------------------------------------------------------------------
+**  Abstract: Writes arguments va to buffer buf according to format fmt
+**  Returns:  Length of string
+**---------------------------------------------------------------------------
+*/
+int ts_formatstring(char *buf, const char *fmt, va_list va)
+{
+	ts_output out = { ts_putstring, buf, 0, 0 };
+	int length = ts_format(&out, fmt, va);
+	*out.buf = 0;
+	return length;
+}
 
 /**
 **---------------------------------------------------------------------------
-**  Abstract: Calculate maximum length of the resulting string from the
-**            format string and va_list va
-**  Returns:  Maximum length
+**  Abstract: Formats arguments va into the buffer of stream fd. Streams
+**            without a buffer of their own use a temporary one, flushed
+**            before returning
+**  Returns:  Number of characters formatted
 **---------------------------------------------------------------------------
 */
-int ts_formatlength(const char *fmt, va_list va)
+int ts_vfprintf(int fd, const char *fmt, va_list va)
 {
-	int length = 0;
-	while (*fmt)
+	ts_output out = { ts_putstream, 0, ts_getstream(fd), 0 };
+	int length;
+
+	if (out.stream)
 	{
-		if (*fmt == '%')
-		{
-			++fmt;
-			switch (*fmt)
-			{
-			  case 'c':
-		  		  va_arg(va, int);
-				  ++length;
-				  break;
-			  case 'd':
-			  case 'i':
-			  case 'u':
-				  /* 32 bits integer is max 11 characters with minus sign */
-				  length += 11;
-				  va_arg(va, int);
-				  break;
-			  case 's':
-			  	  {
-			  		  char * str = va_arg(va, char *);
-			  		  while (*str++)
-			  			  ++length;
-			  	  }
-				  break;
-			  case 'x':
-			  case 'X':
-				  /* 32 bits integer as hex is max 8 characters */
-				  length += 8;
-				  va_arg(va, unsigned int);
-				  break;
-			  default:
-				  ++length;
-				  break;
-			}
-		}
-		else
-		{
-			++length;
-		}
-		++fmt;
+		return ts_format(&out, fmt, va);
+	}
+
+	{
+		ts_stream temporary;
+		temporary.fd = fd;
+		temporary.head = 0;
+		temporary.count = 0;
+		out.stream = &temporary;
+		length = ts_format(&out, fmt, va);
+		ts_streamflush(&temporary);
 	}
 	return length;
 }
 
+/**
+**===========================================================================
+**  Abstract: Passes the characters buffered for stream fd to _write, call
+**            it before a reset or when output must appear without newline
+**  Returns:  0 if successful, EOF otherwise
+**===========================================================================
+*/
+int ts_flush(int fd)
+{
+	ts_stream *stream = ts_getstream(fd);
+	return stream ? ts_streamflush(stream) : 0;
+}
+
 /**
 **===========================================================================
 **  Abstract: Loads data from the given locations and writes them to the
@@ -241,18 +748,11 @@ int siprintf(char *buf, const char *fmt, ...)
 */
 int fiprintf(FILE * stream, const char *fmt, ...)
 {
-	int length = 0;
+	int length;
 	va_list va;
 	va_start(va, fmt);
-	length = ts_formatlength(fmt, va);
+	length = ts_vfprintf(stream->_file, fmt, va);
 	va_end(va);
-	{
-		char buf[length];
-		va_start(va, fmt);
-		length = ts_formatstring(buf, fmt, va);
-		length = _write(stream->_file, buf, length);
-		va_end(va);
-	}
 	return length;
 }
 
@@ -266,18 +766,11 @@ int fiprintf(FILE * stream, const char *fmt, ...)
 */
 int iprintf(const char *fmt, ...)
 {
-	int length = 0;
+	int length;
 	va_list va;
 	va_start(va, fmt);
-	length = ts_formatlength(fmt, va);
+	length = ts_vfprintf(1, fmt, va);
 	va_end(va);
-	{
-		char buf[length];
-		va_start(va, fmt);
-		length = ts_formatstring(buf, fmt, va);
-		length = _write(1, buf, length);
-		va_end(va);
-	}
 	return length;
 }
 
@@ -295,6 +788,7 @@ int fputs(const char *s, FILE *fp)
 	int wlen = 0;
 	int res;
 
+	ts_flush(fp->_file);
 	wlen = _write((fp->_file), (char*)s, length);
 	wlen += _write((fp->_file), "\n", 1);
 
@@ -325,6 +819,7 @@ int puts(const char *s)
 	int numbytes = 0;
 	int res;
 
+	ts_flush(1);
 	numbytes = _write(1, (char*)s, length);
 	numbytes += _write(1, "\n", 1);
 
@@ -350,5 +845,6 @@ int puts(const char *s)
 */
 size_t fwrite(const void * buf, size_t size, size_t count, FILE * fp)
 {
+	ts_flush(fp->_file);
 	return (_write((fp->_file), (char*)buf, size * count) / size);
 }
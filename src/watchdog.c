@@ -0,0 +1,113 @@
+/*
+ * watchdog.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ */
+#include "stm32f4xx.h"
+#include "watchdog.h"
+#include "timer.h"
+#include "timebase.h"
+#include "fault.h"
+#include "sections.h"
+#include "critical.h"
+
+typedef struct {
+	uint32_t deadline;            // ticks
+	volatile uint32_t lastCheckIn; // tick, low word
+} Client;
+
+static CCMRAM_BSS Client clients[WATCHDOG_MAX_CLIENTS];
+static CCMRAM_BSS volatile unsigned int clientCount;
+static CCMRAM_BSS char missed;
+
+static CCMRAM_BSS Timer checkTimer;
+static CCMRAM_BSS Timer idleTimer;
+
+// In the SysTick handler, reloads the IWDG while every client is on time
+static void check(void *arg)
+{
+	uint32_t now = (uint32_t) timebaseGetTicks();
+
+	if (missed) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < clientCount; i++) {
+		// signed: a handler may check in after now was read
+		if ((int32_t) (now - clients[i].lastCheckIn) > (int32_t) clients[i].deadline) {
+			// no more reloads, the IWDG resets
+			missed = 1;
+			faultRecord(FAULT_WATCHDOG, i);
+			return;
+		}
+	}
+
+	IWDG_ReloadCounter();
+}
+
+static void idleCheckIn(void *arg)
+{
+	watchdogCheckIn(WATCHDOG_IDLE_CLIENT);
+}
+
+/**
+ * Starts the IWDG with a timeout of timeoutMs (up to WATCHDOG_MAX_TIMEOUT)
+ * and its supervision. The idle loop becomes client 0 with a deadline of
+ * half the timeout.
+ */
+void watchdogInit(uint32_t timeoutMs)
+{
+	if (timeoutMs > WATCHDOG_MAX_TIMEOUT) {
+		timeoutMs = WATCHDOG_MAX_TIMEOUT;
+	}
+	if (timeoutMs < 4) {
+		timeoutMs = 4;
+	}
+
+	// LSI at 32 kHz divided by 32, one count per ms
+	DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;
+	IWDG_WriteAccessCmd(IWDG_WriteAccess_Enable);
+	IWDG_SetPrescaler(IWDG_Prescaler_32);
+	IWDG_SetReload(timeoutMs);
+	IWDG_ReloadCounter();
+	IWDG_Enable();
+
+	watchdogRegister(timeoutMs / 2);
+
+	timerInit(&idleTimer, idleCheckIn, 0, TIMER_DEFERRED);
+	timerStart(&idleTimer, timeoutMs / 4, timeoutMs / 4);
+	timerInit(&checkTimer, check, 0, TIMER_ISR);
+	timerStart(&checkTimer, timeoutMs / 4, timeoutMs / 4);
+}
+
+/**
+ * Adds a client that must check in every deadlineMs. Returns its index, or
+ * -1 when WATCHDOG_MAX_CLIENTS are registered. Clients cannot be removed.
+ */
+int watchdogRegister(uint32_t deadlineMs)
+{
+	int client = -1;
+
+	uint32_t primask = criticalEnter();
+
+	if (clientCount < WATCHDOG_MAX_CLIENTS) {
+		client = clientCount;
+		clients[client].deadline = deadlineMs;
+		clients[client].lastCheckIn = (uint32_t) timebaseGetTicks();
+		clientCount++;
+	}
+
+	criticalExit(primask);
+	return client;
+}
+
+/**
+ * Marks the client alive. May be called from interrupt handlers.
+ */
+void watchdogCheckIn(int client)
+{
+	if (client >= 0 && client < (int) clientCount) {
+		clients[client].lastCheckIn = (uint32_t) timebaseGetTicks();
+	}
+}
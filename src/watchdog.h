@@ -0,0 +1,51 @@
+/*
+ * watchdog.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: freud
+ *
+ * Independent watchdog (IWDG) supervisor.
+ *
+ * Tasks and loops register as clients with a deadline and check in at
+ * least that often. A TIMER_ISR timer checks the clients every quarter of
+ * the IWDG timeout and reloads the IWDG only if none is late, so a stalled
+ * task resets the device even though interrupts still run. The first late
+ * client is recorded with faultRecord(FAULT_WATCHDOG, client) before the
+ * IWDG expires; the record is saved to EEPROM at the next boot (fault.h).
+ *
+ * Client 0 (WATCHDOG_IDLE_CLIENT) is the idle loop: it checks in from a
+ * deferred timer, which only runs when no scheduler or kernel task hogs the
+ * processor.
+ *
+ * Deadlines should stay below 3/4 of the timeout; a later miss still
+ * resets, but may do so before it is recorded (saved with FAULT_INFO_NONE).
+ * The check timer wakes the tickless system every quarter of the timeout.
+ *
+ * Usage:
+ *
+ *   watchdogInit(1000);                      // 1 s timeout, needs timebaseInit()
+ *   int sensorClient = watchdogRegister(100); // 100 ms deadline
+ *
+ *   while (1) {
+ *       watchdogCheckIn(sensorClient);
+ *       ...
+ *   }
+ *
+ * The IWDG cannot be stopped once started, and it is frozen while the core
+ * is halted by a debugger.
+ */
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <stdint.h>
+
+#define WATCHDOG_MAX_CLIENTS 8
+#define WATCHDOG_MAX_TIMEOUT 4095 // ms, 12 bit reload at 1 kHz
+#define WATCHDOG_IDLE_CLIENT 0
+
+void watchdogInit(uint32_t timeoutMs);
+int watchdogRegister(uint32_t deadlineMs);
+void watchdogCheckIn(int client);
+
+#endif /* WATCHDOG_H_ */
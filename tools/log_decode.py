@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""Decodes the deferred log stream of log.c back into text.
+
+Format strings are read from the .logstr section of the ELF (the record
+ID is the offset of the string in it), %s arguments from the loaded
+sections. The stream is resynchronized on the header magic, so a capture
+may start in the middle of a record.
+
+Usage: log_decode.py [--hclk HZ] ELF CAPTURE
+"""
+
+import argparse
+import re
+import struct
+
+LOG_MAGIC = 0xA
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?([diuxXcsp%])')
+
+
+class Elf:
+    """Just enough of ELF32 little-endian: section contents by name and address."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1:
+            raise ValueError('%s is not an ELF32 file' % path)
+
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x2E)
+        headers = [struct.unpack_from('<IIIIIIIIII', self.data, shoff + i * shentsize)
+                   for i in range(shnum)]
+        names = headers[shstrndx]
+
+        self.sections = []
+        for name, kind, flags, address, offset, size, _, _, _, _ in headers:
+            end = self.data.index(b'\0', names[4] + name)
+            self.sections.append({
+                'name': self.data[names[4] + name:end].decode(),
+                'type': kind, 'flags': flags,
+                'address': address, 'offset': offset, 'size': size,
+            })
+
+    def section(self, name):
+        for section in self.sections:
+            if section['name'] == name:
+                return self.data[section['offset']:section['offset'] + section['size']]
+        raise KeyError('no %s section' % name)
+
+    def string_at(self, address):
+        for section in self.sections:
+            if (section['flags'] & SHF_ALLOC and section['type'] != SHT_NOBITS
+                    and section['address'] <= address < section['address'] + section['size']):
+                start = section['offset'] + address - section['address']
+                return self.data[start:self.data.index(b'\0', start)].decode('ascii', 'replace')
+        return '<0x%08x>' % address
+
+
+def c_string(table, offset):
+    if offset >= len(table):
+        return None
+    end = table.find(b'\0', offset)
+    return table[offset:end].decode('ascii', 'replace')
+
+
+def format_record(elf, text, args):
+    values = iter(args)
+
+    def convert(m):
+        flags, width, precision, kind = m.groups()
+        if kind == '%':
+            return '%'
+        value = next(values, 0)
+        if kind in 'di':
+            value = value - (1 << 32) if value & 0x80000000 else value
+            kind = 'd'
+        elif kind == 'u':
+            kind = 'd'
+        elif kind == 'p':
+            return '0x%08x' % value
+        elif kind == 'c':
+            value = chr(value & 0xFF)
+        elif kind == 's':
+            value = elf.string_at(value)
+        spec = '%' + flags + width + ('.' + precision if precision else '') + kind
+        return spec % value
+
+    return CONVERSION.sub(convert, text)
+
+
+def records(data, table):
+    """Yields (sequence, timestamp, text, args), skipping garbage between records."""
+    i = 0
+    while i + 8 <= len(data):
+        header, = struct.unpack_from('<I', data, i)
+        count = (header >> 16) & 0x0F
+        text = c_string(table, header & 0xFFFF)
+        if header >> 28 != LOG_MAGIC or text is None or i + 8 + 4 * count > len(data):
+            i += 1
+            continue
+        timestamp, = struct.unpack_from('<I', data, i + 4)
+        args = struct.unpack_from('<%dI' % count, data, i + 8)
+        yield (header >> 20) & 0xFF, timestamp, text, args
+        i += 8 + 4 * count
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('elf')
+    parser.add_argument('capture')
+    parser.add_argument('--hclk', type=float, help='CPU clock in Hz, prints microseconds')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    table = elf.section('.logstr')
+    with open(args.capture, 'rb') as f:
+        data = f.read()
+
+    expected = None
+    base = None
+    elapsed = 0
+    for sequence, timestamp, text, values in records(data, table):
+        if expected is not None and sequence != expected:
+            print('! %d records lost' % ((sequence - expected) & 0xFF))
+        expected = (sequence + 1) & 0xFF
+
+        # the cycle counter wraps every 2^32 cycles
+        if base is not None:
+            elapsed += (timestamp - base) & 0xFFFFFFFF
+        base = timestamp
+
+        if args.hclk:
+            stamp = '%12.3f us' % (elapsed * 1e6 / args.hclk)
+        else:
+            stamp = '%12d cy' % elapsed
+        print('%s  %s' % (stamp, format_record(elf, text, values)))
+
+
+if __name__ == '__main__':
+    main()
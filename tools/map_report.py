@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Memory placement report from the GNU ld map file.
+
+Prints the usage of each memory region and lists the input sections placed
+in SRAM code (.ramfunc) and in CCM-RAM (.ccmram, .ccmbss), with their global
+symbols, so that placement changes can be checked after each build. Static
+symbols do not appear in the map, their object file and size still do.
+
+Usage: map_report.py [Debug/smi-lab4.map]
+"""
+
+import re
+import sys
+
+SECTIONS = ('.ramfunc', '.ccmram', '.ccmbss')
+
+REGION = re.compile(r'^(\w+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)', re.I)
+OUTPUT_SECTION = re.compile(r'^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)', re.I)
+INPUT_SECTION = re.compile(r'^ (\.\S+)\s*(?:0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+))?$', re.I)
+CONTINUATION = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$', re.I)
+SYMBOL = re.compile(r'^\s+0x([0-9a-f]+)\s+([A-Za-z_]\w*)$', re.I)
+
+
+def parse(lines):
+    regions = []
+    sections = []
+    placed = []
+    in_regions = False
+    in_map = False
+    pending = None
+    current = None
+
+    for line in lines:
+        line = line.rstrip('\n')
+        if line.startswith('Memory Configuration'):
+            in_regions = True
+            continue
+        if line.startswith('Linker script and memory map'):
+            in_regions = False
+            in_map = True
+            continue
+
+        if in_regions:
+            m = REGION.match(line)
+            if m and m.group(1) != 'Name' and m.group(1) != '*default*':
+                regions.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+            continue
+        if not in_map:
+            continue
+
+        m = OUTPUT_SECTION.match(line)
+        if m:
+            sections.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+            continue
+
+        m = INPUT_SECTION.match(line)
+        if m:
+            name = m.group(1)
+            current = None
+            pending = name if name.startswith(SECTIONS) else None
+            if pending and m.group(2):
+                current = [pending, int(m.group(2), 16), int(m.group(3), 16), m.group(4), []]
+                placed.append(current)
+                pending = None
+            continue
+
+        if pending:
+            m = CONTINUATION.match(line)
+            if m:
+                current = [pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3), []]
+                placed.append(current)
+                pending = None
+            continue
+
+        if current:
+            m = SYMBOL.match(line)
+            if m:
+                current[4].append(m.group(2))
+            elif line.strip() and not line.startswith('  '):
+                current = None
+
+    return regions, sections, placed
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else 'Debug/smi-lab4.map'
+    with open(path) as f:
+        regions, sections, placed = parse(f)
+
+    print('%-10s %10s %10s %10s %6s' % ('Region', 'Origin', 'Used', 'Size', '%'))
+    for name, origin, length in regions:
+        used = sum(size for _, address, size in sections
+                   if origin <= address < origin + length)
+        percent = 100.0 * used / length if length else 0.0
+        print('%-10s 0x%08x %10d %10d %5.1f%%' % (name, origin, used, length, percent))
+
+    for section in SECTIONS:
+        inputs = [p for p in placed if p[0].startswith(section)]
+        print('\n%s (%d bytes)' % (section, sum(p[2] for p in inputs)))
+        for _, address, size, source, symbols in sorted(inputs, key=lambda p: p[1]):
+            print('  0x%08x %6d  %-24s %s' % (address, size, source, ' '.join(symbols)))
+
+
+if __name__ == '__main__':
+    main()
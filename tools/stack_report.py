@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+"""Worst-case stack report per entry point.
+
+Frame sizes come from the .su files written by GCC with -fstack-usage;
+functions without one (assembly, precompiled libraries) are estimated
+from their prologue. The call graph is read from the disassembly of the
+ELF (or from an existing objdump listing such as Debug/smi-lab4.list):
+direct BL/BLX calls and tail branches into other functions.
+
+Entry points are the reset handler (main when it is not found) and every
+handler of the .isr_vector table. A listing has no vector table: handlers
+are then the *_Handler and *_IRQHandler functions that nothing calls.
+Each handler is charged its exception frame (104 bytes with the FPU
+context, lazy stacking reserves it even when unused). The bound for the
+main stack assumes every handler may nest, which holds when priorities
+differ.
+
+Usage: stack_report.py [--limit BYTES] [--objdump TOOL] ELF_OR_LIST SU_DIR...
+
+The main stack size is _estack - _sstack from the symbols of the ELF,
+--limit overrides it (and is needed with a listing). Exits with 1 when the
+bound exceeds it, so it can run as a post build step. Indirect calls and
+recursion cannot be bounded and are reported.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+EXCEPTION_FRAME = 104  # 8 core registers, S0-S15, FPSCR and padding
+
+FUNCTION = re.compile(r'^([0-9a-f]{8}) <([^>]+)>:$')
+INSTRUCTION = re.compile(r'^\s+([0-9a-f]+):\s+(?:[0-9a-f]{4,8}\s+)+(\S+)\s*(.*)$')
+TARGET = re.compile(r'^([0-9a-f]+) <([^>+]+)(\+0x[0-9a-f]+)?>')
+REGISTER_LIST = re.compile(r'\{([^}]*)\}')
+IMMEDIATE = re.compile(r'#(\d+)')
+
+SECTION_WORDS = re.compile(r'^ ([0-9a-f]+) ((?:[0-9a-f]{8} ?){1,4})')
+SYMBOL = re.compile(r'^([0-9a-f]{8}) .*\s(\S+)$')
+
+PROLOGUE_LENGTH = 8  # instructions scanned for push/sub sp
+
+
+class Function:
+    def __init__(self, name, address):
+        self.name = name
+        self.address = address
+        self.frame = None       # bytes, from .su
+        self.estimate = 0       # bytes, from the prologue
+        self.dynamic = False
+        self.calls = set()
+        self.indirect = False
+        self.instructions = 0
+
+    def size(self):
+        return self.frame if self.frame is not None else self.estimate
+
+
+def register_count(operands):
+    m = REGISTER_LIST.search(operands)
+    if not m:
+        return 0
+    count = 0
+    for item in m.group(1).split(','):
+        item = item.strip()
+        if '-' in item:
+            first, last = item.split('-')
+            count += int(last[1:]) - int(first[1:]) + 1
+        elif item:
+            count += 1
+    return count
+
+
+def run_objdump(objdump, options, path):
+    output = subprocess.run([objdump] + options + [path], check=True,
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    return output.stdout.splitlines()
+
+
+def read_disassembly(path, objdump):
+    if path.endswith('.elf'):
+        return run_objdump(objdump, ['-d'], path)
+    with open(path) as f:
+        return f.read().splitlines()
+
+
+def read_vectors(path, objdump):
+    """Returns the handler addresses of the vector table, without the
+    initial stack pointer and the empty entries."""
+    words = []
+    for line in run_objdump(objdump, ['-s', '-j', '.isr_vector'], path):
+        m = SECTION_WORDS.match(line)
+        if m:
+            words += [int.from_bytes(bytes.fromhex(word), 'little') for word in m.group(2).split()]
+    return [word & ~1 for word in words[1:] if word]
+
+
+def read_stack_size(path, objdump):
+    symbols = {}
+    for line in run_objdump(objdump, ['-t'], path):
+        m = SYMBOL.match(line)
+        if m:
+            symbols[m.group(2)] = int(m.group(1), 16)
+    if '_estack' not in symbols or '_sstack' not in symbols:
+        return None
+    return symbols['_estack'] - symbols['_sstack']
+
+
+def parse_disassembly(lines):
+    functions = {}
+    current = None
+
+    for line in lines:
+        m = FUNCTION.match(line)
+        if m:
+            current = functions.setdefault(m.group(2), Function(m.group(2), int(m.group(1), 16)))
+            continue
+        m = INSTRUCTION.match(line)
+        if not m or current is None:
+            continue
+
+        mnemonic, operands = m.group(2), m.group(3)
+        current.instructions += 1
+
+        if current.instructions <= PROLOGUE_LENGTH:
+            if mnemonic in ('push', 'push.w', 'stmdb'):
+                if mnemonic != 'stmdb' or operands.startswith('sp!'):
+                    current.estimate += 4 * register_count(operands)
+            elif mnemonic == 'vpush':
+                current.estimate += 4 * register_count(operands)
+            elif mnemonic in ('sub', 'sub.w', 'subw') and operands.startswith('sp,'):
+                imm = IMMEDIATE.search(operands)
+                if imm:
+                    current.estimate += int(imm.group(1))
+
+        if mnemonic in ('bl', 'blx', 'b', 'b.w', 'b.n') or mnemonic.startswith('b.'):
+            target = TARGET.match(operands)
+            if target:
+                name = target.group(2)
+                # branches inside the function itself are not calls
+                if name != current.name and (mnemonic.startswith('bl') or target.group(3) is None):
+                    current.calls.add(name)
+            elif mnemonic == 'blx':
+                current.indirect = True
+        elif mnemonic == 'bx' and not operands.startswith('lr'):
+            current.indirect = True
+
+    return functions
+
+
+def parse_stack_usage(directories, functions):
+    for directory in directories:
+        for root, _, files in os.walk(directory):
+            for name in files:
+                if not name.endswith('.su'):
+                    continue
+                with open(os.path.join(root, name)) as f:
+                    for line in f:
+                        fields = line.rstrip('\n').split('\t')
+                        if len(fields) < 3:
+                            continue
+                        function = fields[0].rsplit(':', 1)[-1]
+                        if function not in functions:
+                            continue
+                        entry = functions[function]
+                        # static functions may share a name, keep the largest
+                        entry.frame = max(entry.frame or 0, int(fields[1]))
+                        entry.dynamic |= fields[2].startswith('dynamic') and 'bounded' not in fields[2]
+
+
+def worst_case(name, functions, memo, active):
+    """Returns (bytes, path, notes, cut) of the deepest call chain from
+    name. cut holds the callers still being explored where the chain was
+    cut short by recursion."""
+    if name in memo:
+        return memo[name]
+    function = functions.get(name)
+    if function is None:
+        return 0, [name], {'unknown ' + name}, set()
+    if name in active:
+        return 0, [name], {'recursion through ' + name}, {name}
+
+    active.add(name)
+    deepest, path, notes, cut = 0, [], set(), set()
+    for callee in sorted(function.calls):
+        size, callee_path, callee_notes, callee_cut = worst_case(callee, functions, memo, active)
+        notes |= callee_notes
+        cut |= callee_cut
+        if size > deepest or not path:
+            deepest, path = size, callee_path
+    active.discard(name)
+    cut.discard(name)
+
+    if function.indirect:
+        notes.add('indirect call in ' + name)
+    if function.dynamic:
+        notes.add('dynamic frame in ' + name)
+    if function.frame is None:
+        notes.add('estimated ' + name)
+
+    result = (function.size() + deepest, [name] + path, notes, cut)
+    # a chain cut at a caller is only valid below that caller
+    if not cut:
+        memo[name] = result
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('binary', help='ELF file or objdump listing')
+    parser.add_argument('su_dirs', nargs='*', default=['.'], help='directories searched for .su files')
+    parser.add_argument('--limit', type=lambda v: int(v, 0),
+                        help='main stack size in bytes, _estack - _sstack of the ELF by default')
+    parser.add_argument('--objdump', default='arm-atollic-eabi-objdump')
+    parser.add_argument('--verbose', action='store_true', help='print the notes of every entry point')
+    args = parser.parse_args()
+
+    functions = parse_disassembly(read_disassembly(args.binary, args.objdump))
+    parse_stack_usage(args.su_dirs, functions)
+
+    thread = 'Reset_Handler' if 'Reset_Handler' in functions else 'main'
+    limit = args.limit
+    if args.binary.endswith('.elf'):
+        # handlers sharing a vector (Default_Handler) are counted once
+        names = {f.address: f.name for f in functions.values()}
+        handlers = {names[a] for a in read_vectors(args.binary, args.objdump) if a in names}
+        if limit is None:
+            limit = read_stack_size(args.binary, args.objdump)
+    else:
+        called = set().union(*(f.calls for f in functions.values()))
+        handlers = {n for n in functions if n not in called
+                    and (n.endswith('_Handler') or n.endswith('_IRQHandler'))}
+    entries = [thread] + sorted(handlers - {thread})
+    memo = {}
+    total = 0
+
+    print('%-28s %8s  %s' % ('Entry point', 'Bytes', 'Deepest path'))
+    for entry in entries:
+        size, path, notes, _ = worst_case(entry, functions, memo, set())
+        if entry != thread:
+            size += EXCEPTION_FRAME
+        total += size
+        print('%-28s %8d  %s' % (entry, size, ' > '.join(path)))
+        shown = sorted(n for n in notes if args.verbose or not n.startswith('estimated'))
+        for note in shown:
+            print('%-28s %8s  ! %s' % ('', '', note))
+
+    print('\nMain stack bound (reset + nested handlers): %d bytes' % total)
+    if limit is not None:
+        print('Main stack size: %d bytes, %d left' % (limit, limit - total))
+        if total > limit:
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Decodes a captured SWO byte stream (ITM packets) into a timeline.
+
+Text on stimulus port 0 is printed a line at a time, events on the other
+ports one per packet, each with the time of the local timestamp packet
+that follows it. Timestamps are in CPU cycles (itm.c sets no prescaler);
+--hclk converts them to microseconds.
+
+The capture is the raw SWO output: a file saved by the debugger's SWV
+console, or a UART capture of PB3 when itmInit() was given a baud rate.
+
+Usage: swo_decode.py [--hclk HZ] CAPTURE
+"""
+
+import argparse
+
+# must follow ItmEvent in src/itm.h
+EVENTS = {
+    1: 'eeprom.program',
+    2: 'eeprom.ready',
+    3: 'eeprom.remap',
+    4: 'clock.change',
+}
+USER_PORT = 16
+
+
+def packets(data):
+    """Yields ('sw', port, value, size), ('ts', delta) and ('overflow',)."""
+    i = 0
+    length = len(data)
+    while i < length:
+        header = data[i]
+        i += 1
+
+        if header == 0x00:
+            # synchronization: zeros then 0x80
+            while i < length and data[i] == 0x00:
+                i += 1
+            if i < length and data[i] == 0x80:
+                i += 1
+        elif header == 0x70:
+            yield ('overflow',)
+        elif header & 0x0F == 0x00:
+            # local timestamp, format 2 (single byte) or format 1
+            if header & 0x80:
+                delta = 0
+                shift = 0
+                while i < length:
+                    byte = data[i]
+                    i += 1
+                    delta |= (byte & 0x7F) << shift
+                    shift += 7
+                    if not byte & 0x80:
+                        break
+            else:
+                delta = (header >> 4) & 0x07
+            yield ('ts', delta)
+        elif header & 0x0B == 0x08:
+            # extension packet, skip its continuation bytes
+            if header & 0x80:
+                while i < length and data[i] & 0x80:
+                    i += 1
+                i += 1
+        elif header & 0x03:
+            size = (1, 2, 4)[(header & 0x03) - 1]
+            payload = data[i:i + size]
+            i += size
+            if len(payload) < size:
+                break
+            value = int.from_bytes(payload, 'little')
+            if header & 0x04:
+                continue  # hardware source (DWT), not used here
+            yield ('sw', header >> 3, value, size)
+        # anything else is a global timestamp or reserved, one byte long
+
+
+def timeline(data):
+    """Yields (cycles, port, value, size) with the time of each packet."""
+    now = 0
+    pending = []
+    for packet in packets(data):
+        if packet[0] == 'ts':
+            now += packet[1]
+            for port, value, size in pending:
+                yield now, port, value, size
+            pending = []
+        elif packet[0] == 'sw':
+            pending.append(packet[1:])
+        elif packet[0] == 'overflow':
+            pending.append((None, 0, 0))
+    for port, value, size in pending:
+        yield now, port, value, size
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('capture')
+    parser.add_argument('--hclk', type=float, help='CPU clock in Hz, prints microseconds')
+    args = parser.parse_args()
+
+    with open(args.capture, 'rb') as f:
+        data = f.read()
+
+    def stamp(cycles):
+        if args.hclk:
+            return '%12.3f us' % (cycles * 1e6 / args.hclk)
+        return '%12d cy' % cycles
+
+    line = b''
+    line_time = None
+    for cycles, port, value, size in timeline(data):
+        if port is None:
+            print('%s  ! overflow, packets lost' % stamp(cycles))
+        elif port == 0:
+            if line_time is None:
+                line_time = cycles
+            line += value.to_bytes(size, 'little')
+            while b'\n' in line:
+                text, line = line.split(b'\n', 1)
+                print('%s  %s' % (stamp(line_time), text.decode('ascii', 'replace')))
+                line_time = cycles if line else None
+        else:
+            name = EVENTS.get(port, 'user%d' % (port - USER_PORT) if port >= USER_PORT else 'port%d' % port)
+            print('%s  %-16s 0x%08x (%d)' % (stamp(cycles), name, value, value))
+
+    if line:
+        print('%s  %s' % (stamp(line_time), line.decode('ascii', 'replace')))
+
+
+if __name__ == '__main__':
+    main()